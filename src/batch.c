@@ -0,0 +1,164 @@
+#include <inttypes.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "batch.h"
+#include "board.h"
+#include "eval.h"
+#include "hashtable.h"
+#include "movepicker.h"
+#include "packed.h"
+#include "search.h"
+#include "uci.h"
+#include "utils.h"
+
+// Positions a thread takes from the batch at once
+#define BATCH_CHUNK_SIZE 64
+
+// Hash size of each search thread, it is cleared for every position
+#define BATCH_HASH_MB 4
+
+typedef struct {
+    const PackedBoard *positions;
+    size_t count;
+    atomic_size_t next;       // First position which no thread has taken yet
+
+    int nodes;                // Nodes per search, 0 to only evaluate
+    int *scores;
+    Move *moves;
+} Batch;
+
+// Takes the next chunk of positions, false once they are all taken.
+static bool takeChunk(Batch *batch, size_t *first, size_t *last) {
+    *first = atomic_fetch_add(&batch->next, BATCH_CHUNK_SIZE);
+    *last = MIN(*first + BATCH_CHUNK_SIZE, batch->count);
+    return *first < batch->count;
+}
+
+static void *evaluateWorker(void *arg) {
+    Batch *batch = arg;
+    Board *board = malloc(sizeof(Board));
+    size_t first, last;
+
+    while (takeChunk(batch, &first, &last)) {
+        for (size_t i = first; i < last; i++) {
+            unpackBoard(&batch->positions[i], board);
+            int score = evaluate(board);
+            batch->scores[i] = (board->side == WHITE) ? score : -score;
+        }
+    }
+
+    free(board);
+    return NULL;
+}
+
+/**
+ * Every position is searched from a clear hash table and history, so the
+ * results don't depend on which thread searched what before.
+ */
+static void *searchWorker(void *arg) {
+    Batch *batch = arg;
+    initHashTable(BATCH_HASH_MB);
+    Engine *engine = malloc(sizeof(Engine));
+    initEngine(engine);
+    engine->silent = true;
+    engine->pollInput = false;
+
+    SearchLimits limits = {0};
+    limits.depth = MAX_DEPTH - 1;
+    limits.nodes = batch->nodes;
+    limits.searchType = LIMIT_NODES;
+
+    size_t first, last;
+    while (takeChunk(batch, &first, &last)) {
+        for (size_t i = first; i < last; i++) {
+            unpackBoard(&batch->positions[i], &engine->board);
+            clearHashTable();
+            clearMoveHistory();
+
+            initSearch(engine, limits);
+            Move move = iterativeDeepening(engine);
+            int score = engine->searchStats.score;
+
+            batch->scores[i] = (engine->board.side == WHITE) ? score : -score;
+            if (batch->moves)
+                batch->moves[i] = move;
+        }
+    }
+
+    free(engine);
+    cleanUpHashTable();
+    return NULL;
+}
+
+static void runBatch(Batch *batch, int threads, void *(*worker)(void *)) {
+    if (threads <= 0)
+        threads = cpuCount();
+
+    atomic_init(&batch->next, 0);
+    pthread_t *handles = malloc(threads * sizeof(pthread_t));
+    for (int i = 0; i < threads; i++)
+        pthread_create(&handles[i], NULL, worker, batch);
+    for (int i = 0; i < threads; i++)
+        pthread_join(handles[i], NULL);
+
+    free(handles);
+}
+
+// Evaluates every position with the static evaluation, see batch.h.
+void evaluateBatch(const PackedBoard *positions, size_t count, int *scores, int threads) {
+    Batch batch = { .positions = positions, .count = count, .scores = scores };
+    runBatch(&batch, threads, evaluateWorker);
+}
+
+// Searches every position with a fixed number of nodes, see batch.h.
+void searchBatch(const PackedBoard *positions, size_t count, int nodes, int *scores, Move *moves, int threads) {
+    Batch batch = { .positions = positions, .count = count, .nodes = nodes, .scores = scores, .moves = moves };
+    runBatch(&batch, threads, searchWorker);
+}
+
+// Runs a batch over a packed file and reports its throughput.
+void runBatchFile(const char *path, bool search, int nodes, int threads) {
+    size_t size;
+    const PackedBoard *positions = (const PackedBoard *) mapFile(path, &size);
+    if (positions == NULL) {
+        printf("Could not open %s\n", path);
+        return;
+    }
+
+    size_t count = size / sizeof(PackedBoard);
+    int *scores = malloc(count * sizeof(int));
+
+    // Decoding on its own first, on one thread
+    Board *board = malloc(sizeof(Board));
+    U64 checksum = 0;
+    int start = getTime();
+    for (size_t i = 0; i < count; i++) {
+        unpackBoard(&positions[i], board);
+        checksum += board->hash;
+    }
+    int elapsed = MAX(getTime() - start, 1);
+    printf("Unpacked %zu positions in %d ms, %.0f positions/s (checksum %" PRIx64 ")\n",
+           count, elapsed, count * 1000.0 / elapsed, checksum);
+    free(board);
+
+    start = getTime();
+    if (search)
+        searchBatch(positions, count, nodes, scores, NULL, threads);
+    else
+        evaluateBatch(positions, count, scores, threads);
+    elapsed = MAX(getTime() - start, 1);
+
+    // Compare against the scores stored with the positions
+    double error = 0.0;
+    for (size_t i = 0; i < count; i++)
+        error += abs(scores[i] - positions[i].score);
+
+    printf("%s %zu positions in %d ms, %.0f positions/s, mean difference from stored scores %.1f\n",
+           search ? "Searched" : "Evaluated", count, elapsed, count * 1000.0 / elapsed, error / MAX(count, 1));
+
+    free(scores);
+    unmapFile((const char *) positions, size);
+}
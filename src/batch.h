@@ -0,0 +1,28 @@
+// Batch evaluation and search of packed positions.
+//
+// Runs the evaluation, or a fixed node search, on every position of an array
+// of packed positions, spread over a pool of threads. Threads take small chunks
+// of positions at a time from a shared counter, so slow positions (long
+// searches) don't leave the other threads idle at the end.
+//
+// Usage: batch <eval|search> <positions.bin> [nodes] [threads]
+// Runs a batch over a packed file, e.g. from datagen, and reports the
+// throughput in positions per second.
+
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "move.h"
+#include "packed.h"
+
+#define BATCH_DEFAULT_NODES 5000
+
+// Static evaluation of each position, from White's POV
+void evaluateBatch(const PackedBoard *positions, size_t count, int *scores, int threads);
+
+// Search score (from White's POV) and best move of each position, at a fixed number of nodes
+void searchBatch(const PackedBoard *positions, size_t count, int nodes, int *scores, Move *moves, int threads);
+
+void runBatchFile(const char *path, bool search, int nodes, int threads);
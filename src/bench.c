@@ -7,6 +7,7 @@
 #include "bench.h"
 #include "uci.h"
 #include "utils.h"
+#include "sliders.h"
 
 // Runs a benchmark test suite on multiple positions
 void bench() {
@@ -56,4 +57,65 @@ void bench() {
     printf("Time: %d ms\n", totalTime);
     printf("Nodes searched: %" PRIu64 "\n", totalNodes);
     printf("NPS: %.0f\n", nps);
-}
\ No newline at end of file
+}
+
+/**
+ * Micro-benchmark of slider attack generation, comparing magic lookups against
+ * the AVX2 Kogge-Stone fills on the same random occupancies. Also checks that
+ * both agree before timing anything.
+ */
+#define SLIDER_BENCH_BOARDS 4096
+#define SLIDER_BENCH_ROUNDS 200
+
+void sliderBench() {
+    static U64 occupancies[SLIDER_BENCH_BOARDS];
+    for (int i = 0; i < SLIDER_BENCH_BOARDS; i++)
+        occupancies[i] = randomU64() & randomU64();
+
+    U64 lookups = (U64)SLIDER_BENCH_BOARDS * SLIDER_BENCH_ROUNDS * 64;
+    U64 checksum = 0;
+
+    // Magic bitboards
+    int start = getTime();
+    for (int round = 0; round < SLIDER_BENCH_ROUNDS; round++) {
+        for (int i = 0; i < SLIDER_BENCH_BOARDS; i++) {
+            for (int sq = 0; sq < 64; sq++)
+                checksum += Bmagic(sq, occupancies[i]) ^ Rmagic(sq, occupancies[i]);
+        }
+    }
+    int elapsed = MAX(getTime() - start, 1);
+#ifdef USE_PEXT
+    printf("PEXT:        %d ms, %.1f M queen lookups/s\n", elapsed, lookups / (elapsed * 1000.0));
+#else
+    printf("Magics:      %d ms, %.1f M queen lookups/s\n", elapsed, lookups / (elapsed * 1000.0));
+#endif
+
+#ifdef KOGGE_STONE_AVAILABLE
+    // Check both implementations agree
+    int mismatches = 0;
+    for (int i = 0; i < SLIDER_BENCH_BOARDS; i++) {
+        for (int sq = 0; sq < 64; sq++) {
+            mismatches += bishopAttacksKS(1ULL << sq, occupancies[i]) != Bmagic(sq, occupancies[i]);
+            mismatches += rookAttacksKS(1ULL << sq, occupancies[i]) != Rmagic(sq, occupancies[i]);
+        }
+    }
+    if (mismatches)
+        printf("Kogge-Stone disagrees with magics %d times!\n", mismatches);
+
+    // Kogge-Stone, one slider at a time
+    start = getTime();
+    for (int round = 0; round < SLIDER_BENCH_ROUNDS; round++) {
+        for (int i = 0; i < SLIDER_BENCH_BOARDS; i++) {
+            for (int sq = 0; sq < 64; sq++)
+                checksum += bishopAttacksKS(1ULL << sq, occupancies[i]) ^ rookAttacksKS(1ULL << sq, occupancies[i]);
+        }
+    }
+    elapsed = MAX(getTime() - start, 1);
+    printf("Kogge-Stone: %d ms, %.1f M queen lookups/s\n", elapsed, lookups / (elapsed * 1000.0));
+#else
+    puts("Kogge-Stone: not available, needs AVX2");
+#endif
+
+    // Print the checksum so the compiler can't optimise the loops away
+    printf("Checksum: %" PRIx64 "\n", checksum);
+}
@@ -8,3 +8,9 @@
  * search was affected by any changes made.
  */
 void bench();
+
+/**
+ * Times magic lookups against the Kogge-Stone slider attacks, after checking
+ * that both agree.
+ */
+void sliderBench();
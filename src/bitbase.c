@@ -0,0 +1,591 @@
+#include <assert.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "bitbase.h"
+#include "bitboards.h"
+#include "board.h"
+#include "makemove.h"
+#include "movegen.h"
+#include "sliders.h"
+#include "utils.h"
+#include "zobrist.h"
+
+// Pieces a bitbase can have besides the kings
+#define BITBASE_MAX_PIECES 2
+
+// Positions a thread takes at once while generating
+#define BITBASE_CHUNK_SIZE 4096
+
+typedef struct {
+    const char *name;
+    int count;                          // Pieces besides the kings
+    int pieces[BITBASE_MAX_PIECES];
+    int colors[BITBASE_MAX_PIECES];
+    bool pawns;
+    int kingSquares;                    // Squares the white king is mirrored into
+    size_t positions;
+    U64 key;                            // Material key with the colors of the name
+    U64 flippedKey;                     // Material key with the colors swapped
+    uint8_t *data;                      // 2 bits per position, NULL if not loaded
+    bool mapped;
+} Bitbase;
+
+// In the order they are generated in, each only converts into ones before it
+static Bitbase bitbases[] = {
+    { .name = "KNK" }, { .name = "KBK" }, { .name = "KRK" }, { .name = "KQK" }, { .name = "KPK" },
+    { .name = "KQKQ" }, { .name = "KQKR" }, { .name = "KQKB" }, { .name = "KQKN" },
+    { .name = "KRKR" }, { .name = "KRKB" }, { .name = "KRKN" },
+    { .name = "KQKP" }, { .name = "KRKP" },
+};
+
+#define BITBASE_COUNT ((int) (sizeof(bitbases) / sizeof(Bitbase)))
+
+// Most pieces of any loaded bitbase, 0 if none are loaded
+int bitbasePieces = 0;
+
+// Index of the white king's square after mirroring, -1 if it is mirrored away
+static int triangleIndex[64], halfIndex[64];
+static int triangleSquares[10], halfSquares[32];
+
+/* -------------------------------------------------------------------------- */
+/*                                  Indexing                                  */
+/* -------------------------------------------------------------------------- */
+
+// Applies one of the 8 symmetries of the board to a square
+static inline int transform(int sq, int symmetry) {
+    if (symmetry & 4) sq = ((sq & 7) << 3) | (sq >> 3);
+    if (symmetry & 2) sq ^= 56;
+    if (symmetry & 1) sq ^= 7;
+    return sq;
+}
+
+/**
+ * Index of a position from its squares: the white king, the black king, then
+ * the other pieces in the order of the name. Symmetric positions get the
+ * lowest index of all their mirror images, so they're only stored once.
+ */
+static size_t positionIndex(const Bitbase *bb, int side, const int *squares) {
+    int symmetries = bb->pawns ? 2 : 8;
+    size_t best = SIZE_MAX;
+
+    for (int symmetry = 0; symmetry < symmetries; symmetry++) {
+        int king = transform(squares[0], symmetry);
+        int kingIndex = bb->pawns ? halfIndex[king] : triangleIndex[king];
+        if (kingIndex < 0)
+            continue;
+
+        size_t index = side * bb->kingSquares + kingIndex;
+        for (int i = 1; i < bb->count + 2; i++)
+            index = index * 64 + transform(squares[i], symmetry);
+
+        best = MIN(best, index);
+    }
+
+    return best;
+}
+
+// Squares of a position from its index, returns the side to move
+static int decodeIndex(const Bitbase *bb, size_t index, int *squares) {
+    for (int i = bb->count + 1; i >= 1; i--) {
+        squares[i] = index % 64;
+        index /= 64;
+    }
+
+    squares[0] = (bb->pawns ? halfSquares : triangleSquares)[index % bb->kingSquares];
+    return index / bb->kingSquares;
+}
+
+/**
+ * Squares of the pieces on the board in the order of the bitbase, and the
+ * side to move. Flipped boards are looked at from the other side, so the
+ * colors match the bitbase.
+ */
+static int boardSquares(const Bitbase *bb, Board *board, bool flipped, int *squares) {
+    int white = flipped ? BLACK : WHITE;
+    int flip = flipped ? 56 : 0;
+
+    squares[0] = getlsb(board->pieces[KING] & board->colors[white]) ^ flip;
+    squares[1] = getlsb(board->pieces[KING] & board->colors[!white]) ^ flip;
+    for (int i = 0; i < bb->count; i++) {
+        int color = (bb->colors[i] == WHITE) ? white : !white;
+        squares[i + 2] = getlsb(board->pieces[bb->pieces[i]] & board->colors[color]) ^ flip;
+    }
+
+    return flipped ? !board->side : board->side;
+}
+
+static inline int readResult(const uint8_t *data, size_t index) {
+    return (data[index / 4] >> (2 * (index % 4))) & 3;
+}
+
+static Bitbase *findBitbase(U64 materialKey, bool *flipped) {
+    for (int i = 0; i < BITBASE_COUNT; i++) {
+        if (bitbases[i].key == materialKey || bitbases[i].flippedKey == materialKey) {
+            *flipped = bitbases[i].key != materialKey;
+            return &bitbases[i];
+        }
+    }
+    return NULL;
+}
+
+void initBitbases() {
+    int triangle = 0, half = 0;
+    for (int sq = 0; sq < 64; sq++) {
+        triangleIndex[sq] = halfIndex[sq] = -1;
+
+        if (fileOf(sq) <= 3) {
+            halfSquares[half] = sq;
+            halfIndex[sq] = half++;
+        }
+
+        if (fileOf(sq) <= 3 && rankOf(sq) <= fileOf(sq)) {
+            triangleSquares[triangle] = sq;
+            triangleIndex[sq] = triangle++;
+        }
+    }
+
+    // Piece lists and material keys from the names
+    for (int i = 0; i < BITBASE_COUNT; i++) {
+        Bitbase *bb = &bitbases[i];
+        bb->count = 0;
+        bb->pawns = false;
+        bb->key = bb->flippedKey = MATERIAL_KEY(toPiece(KING, WHITE)) + MATERIAL_KEY(toPiece(KING, BLACK));
+
+        int color = WHITE;
+        for (const char *c = bb->name + 1; *c; c++) {
+            if (*c == 'K') {
+                color = BLACK;
+                continue;
+            }
+
+            int piece = strchr("PNBRQ", *c) - "PNBRQ";
+            bb->pieces[bb->count] = piece;
+            bb->colors[bb->count] = color;
+            bb->count++;
+            bb->pawns |= piece == PAWN;
+            bb->key += MATERIAL_KEY(toPiece(piece, color));
+            bb->flippedKey += MATERIAL_KEY(toPiece(piece, !color));
+        }
+
+        bb->kingSquares = bb->pawns ? 32 : 10;
+        bb->positions = 2 * bb->kingSquares;
+        for (int j = 0; j < bb->count + 1; j++)
+            bb->positions *= 64;
+    }
+}
+
+/* -------------------------------------------------------------------------- */
+/*                                   Probing                                  */
+/* -------------------------------------------------------------------------- */
+
+static void unloadBitbase(Bitbase *bb) {
+    size_t size = (bb->positions + 3) / 4;
+    if (bb->data && bb->mapped)
+        unmapFile((const char *) bb->data, size);
+    else
+        free(bb->data);
+
+    bb->data = NULL;
+}
+
+// Maps every bitbase found in the directory, returns how many were found.
+int loadBitbases(const char *directory) {
+    int loaded = 0;
+    bitbasePieces = 0;
+
+    for (int i = 0; i < BITBASE_COUNT; i++) {
+        Bitbase *bb = &bitbases[i];
+        unloadBitbase(bb);
+
+        char path[FILENAME_MAX];
+        snprintf(path, sizeof(path), "%s/%s.bb", directory, bb->name);
+
+        size_t size;
+        const char *data = mapFile(path, &size);
+        if (data == NULL)
+            continue;
+
+        if (size != (bb->positions + 3) / 4) {
+            printf("info string Bitbase %s has the wrong size\n", path);
+            unmapFile(data, size);
+            continue;
+        }
+
+        bb->data = (uint8_t *) data;
+        bb->mapped = true;
+        bitbasePieces = MAX(bitbasePieces, bb->count + 2);
+        loaded++;
+    }
+
+    return loaded;
+}
+
+/**
+ * Result of the position for the side to move, BITBASE_UNKNOWN if there is no
+ * bitbase for its material.
+ */
+int probeBitbase(Board *board) {
+    // Bare kings, e.g. after capturing the last piece while generating
+    if (board->colors[BOTH] == board->pieces[KING])
+        return BITBASE_DRAW;
+
+    if (board->castlePerm)
+        return BITBASE_UNKNOWN;
+
+    bool flipped;
+    Bitbase *bb = findBitbase(board->materialKey, &flipped);
+    if (bb == NULL || bb->data == NULL)
+        return BITBASE_UNKNOWN;
+
+    int squares[BITBASE_MAX_PIECES + 2];
+    int side = boardSquares(bb, board, flipped, squares);
+    return readResult(bb->data, positionIndex(bb, side, squares));
+}
+
+/* -------------------------------------------------------------------------- */
+/*                                 Generation                                 */
+/* -------------------------------------------------------------------------- */
+
+// State of a position while generating
+enum {
+    GEN_UNKNOWN,
+    GEN_CAN_DRAW,             // Unknown, but it has a move into a drawn smaller endgame
+    GEN_WIN,
+    GEN_LOSS,
+    GEN_DRAW,
+    GEN_INVALID               // Impossible positions, and mirror images of others
+};
+
+typedef struct {
+    uint32_t *items;
+    size_t count, capacity;
+} PositionList;
+
+typedef struct {
+    Bitbase *bb;
+    atomic_uchar *states;
+    atomic_uchar *moves;      // Moves to positions in the bitbase which aren't known to be won yet
+    const PositionList *wave; // Solved positions to pass back, NULL for the first look at every position
+    atomic_size_t next;
+    size_t end;
+} Generator;
+
+typedef struct {
+    Generator *gen;
+    Board *board;
+    PositionList solved;      // Positions this thread solved
+} GeneratorThread;
+
+static void pushPosition(PositionList *list, uint32_t index) {
+    if (list->count == list->capacity) {
+        list->capacity = MAX(2 * list->capacity, 1024);
+        list->items = realloc(list->items, list->capacity * sizeof(uint32_t));
+    }
+    list->items[list->count++] = index;
+}
+
+static bool addUnique(uint32_t *list, int *count, uint32_t index) {
+    for (int i = 0; i < *count; i++) {
+        if (list[i] == index)
+            return false;
+    }
+    list[(*count)++] = index;
+    return true;
+}
+
+// Pieces on top of each other, or pawns on the first or last rank
+static bool validSquares(const Bitbase *bb, const int *squares) {
+    U64 occupied = 0ULL;
+    for (int i = 0; i < bb->count + 2; i++) {
+        if (testBit(occupied, squares[i]))
+            return false;
+        setBit(&occupied, squares[i]);
+
+        if (i >= 2 && bb->pieces[i - 2] == PAWN && (rankOf(squares[i]) == 0 || rankOf(squares[i]) == 7))
+            return false;
+    }
+    return true;
+}
+
+static void setUpBoard(const Bitbase *bb, Board *board, int side, const int *squares) {
+    clearBoard(board);
+    setPiece(board, WHITE, KING, squares[0]);
+    setPiece(board, BLACK, KING, squares[1]);
+    for (int i = 0; i < bb->count; i++)
+        setPiece(board, bb->colors[i], bb->pieces[i], squares[i + 2]);
+    board->side = side;
+    board->hash = generateHash(board);
+}
+
+/**
+ * First look at a position: solves mates, stalemates and positions decided by
+ * a capture or promotion into a smaller endgame, and counts the moves which
+ * stay in this one.
+ */
+static void solvePosition(GeneratorThread *thread, size_t index) {
+    Generator *gen = thread->gen;
+    Bitbase *bb = gen->bb;
+    Board *board = thread->board;
+
+    int squares[BITBASE_MAX_PIECES + 2];
+    int side = decodeIndex(bb, index, squares);
+    if (!validSquares(bb, squares) || positionIndex(bb, side, squares) != index) {
+        atomic_store(&gen->states[index], GEN_INVALID);
+        return;
+    }
+
+    // The side which just moved can't be in check
+    setUpBoard(bb, board, side, squares);
+    if (isSquareAttacked(board, !side, getlsb(board->pieces[KING] & board->colors[!side]))) {
+        atomic_store(&gen->states[index], GEN_INVALID);
+        return;
+    }
+
+    MoveList moves;
+    generatePseudoLegalMoves(&moves, board);
+
+    uint32_t children[MAX_LEGAL_MOVES];
+    int childCount = 0, legalMoves = 0;
+    bool win = false, canDraw = false;
+
+    for (int i = 0; i < moves.count && !win; i++) {
+        Move move = moves.list[i];
+        if (!makeMove(board, move)) {
+            undoMove(board, move);
+            continue;
+        }
+
+        legalMoves++;
+        if (IsCapture(move) || IsPromotion(move)) {
+            int result = probeBitbase(board);
+            assert(result != BITBASE_UNKNOWN);
+            win |= result == BITBASE_LOSS;
+            canDraw |= result == BITBASE_DRAW;
+        } else {
+            int childSquares[BITBASE_MAX_PIECES + 2];
+            int childSide = boardSquares(bb, board, false, childSquares);
+            addUnique(children, &childCount, positionIndex(bb, childSide, childSquares));
+        }
+
+        undoMove(board, move);
+    }
+
+    int state;
+    if (legalMoves == 0)
+        state = boardIsInCheck(board) ? GEN_LOSS : GEN_DRAW;
+    else if (win)
+        state = GEN_WIN;
+    else if (childCount == 0)
+        state = canDraw ? GEN_DRAW : GEN_LOSS;
+    else
+        state = canDraw ? GEN_CAN_DRAW : GEN_UNKNOWN;
+
+    atomic_store(&gen->moves[index], childCount);
+    atomic_store(&gen->states[index], state);
+    if (state == GEN_WIN || state == GEN_LOSS)
+        pushPosition(&thread->solved, index);
+}
+
+// Where a piece on a square could have moved from, to empty squares
+static U64 moveOrigins(int piece, int color, int sq, U64 occupied) {
+    U64 origins = 0ULL;
+
+    switch (piece) {
+        case KING:   origins = kingAttacks(sq); break;
+        case KNIGHT: origins = knightAttacks(sq); break;
+        case BISHOP: origins = bishopAttacks(sq, occupied); break;
+        case ROOK:   origins = rookAttacks(sq, occupied); break;
+        case QUEEN:  origins = bishopAttacks(sq, occupied) | rookAttacks(sq, occupied); break;
+        case PAWN: {
+            // Single pushes from the second rank on, double pushes from the second rank
+            int from = (color == WHITE) ? sq - 8 : sq + 8;
+            int relativeRank = (color == WHITE) ? rankOf(sq) : 7 - rankOf(sq);
+            if (relativeRank >= 2 && !testBit(occupied, from)) {
+                setBit(&origins, from);
+                if (relativeRank == 3)
+                    setBit(&origins, (color == WHITE) ? from - 8 : from + 8);
+            }
+            break;
+        }
+    }
+
+    return origins & ~occupied;
+}
+
+/**
+ * Passes a solved position back to the positions before it. Moving into a lost
+ * position wins, and once every move of a position leads into a won one it is
+ * lost. Moves into the same position are only counted once, like when the
+ * moves were counted.
+ */
+static void passBack(GeneratorThread *thread, uint32_t index) {
+    Generator *gen = thread->gen;
+    Bitbase *bb = gen->bb;
+
+    int squares[BITBASE_MAX_PIECES + 2];
+    int side = decodeIndex(bb, index, squares);
+    int mover = !side;
+    bool lost = atomic_load(&gen->states[index]) == GEN_LOSS;
+
+    U64 occupied = 0ULL;
+    for (int i = 0; i < bb->count + 2; i++)
+        setBit(&occupied, squares[i]);
+
+    uint32_t parents[MAX_LEGAL_MOVES];
+    int parentCount = 0;
+
+    for (int i = 0; i < bb->count + 2; i++) {
+        int piece = (i < 2) ? KING : bb->pieces[i - 2];
+        int color = (i < 2) ? i : bb->colors[i - 2];
+        if (color != mover)
+            continue;
+
+        int sq = squares[i];
+        U64 origins = moveOrigins(piece, color, sq, occupied);
+        while (origins) {
+            squares[i] = poplsb(&origins);
+            uint32_t parent = positionIndex(bb, mover, squares);
+            squares[i] = sq;
+
+            if (!addUnique(parents, &parentCount, parent))
+                continue;
+
+            unsigned char state = atomic_load(&gen->states[parent]);
+            if (state != GEN_UNKNOWN && state != GEN_CAN_DRAW)
+                continue;
+
+            if (lost) {
+                if (atomic_compare_exchange_strong(&gen->states[parent], &state, GEN_WIN))
+                    pushPosition(&thread->solved, parent);
+            } else if (atomic_fetch_sub(&gen->moves[parent], 1) == 1) {
+                unsigned char unknown = GEN_UNKNOWN;
+                if (atomic_compare_exchange_strong(&gen->states[parent], &unknown, GEN_LOSS))
+                    pushPosition(&thread->solved, parent);
+            }
+        }
+    }
+}
+
+static void *generatorWorker(void *arg) {
+    GeneratorThread *thread = arg;
+    Generator *gen = thread->gen;
+
+    size_t first;
+    while ((first = atomic_fetch_add(&gen->next, BITBASE_CHUNK_SIZE)) < gen->end) {
+        size_t last = MIN(first + BITBASE_CHUNK_SIZE, gen->end);
+        for (size_t i = first; i < last; i++) {
+            if (gen->wave)
+                passBack(thread, gen->wave->items[i]);
+            else
+                solvePosition(thread, i);
+        }
+    }
+
+    return NULL;
+}
+
+// Runs a pass over every position, or over a wave of solved ones, and collects the newly solved positions
+static void runPass(Generator *gen, GeneratorThread *threads, int threadCount, PositionList *solved) {
+    atomic_init(&gen->next, 0);
+    gen->end = gen->wave ? gen->wave->count : gen->bb->positions;
+
+    pthread_t *handles = malloc(threadCount * sizeof(pthread_t));
+    for (int i = 0; i < threadCount; i++)
+        pthread_create(&handles[i], NULL, generatorWorker, &threads[i]);
+
+    solved->count = 0;
+    for (int i = 0; i < threadCount; i++) {
+        pthread_join(handles[i], NULL);
+        for (size_t j = 0; j < threads[i].solved.count; j++)
+            pushPosition(solved, threads[i].solved.items[j]);
+        threads[i].solved.count = 0;
+    }
+
+    free(handles);
+}
+
+static void generateBitbase(Bitbase *bb, const char *directory, int threadCount) {
+    int start = getTime();
+
+    Generator gen = { .bb = bb, .wave = NULL };
+    gen.states = malloc(bb->positions);
+    gen.moves = malloc(bb->positions);
+
+    GeneratorThread *threads = calloc(threadCount, sizeof(GeneratorThread));
+    for (int i = 0; i < threadCount; i++) {
+        threads[i].gen = &gen;
+        threads[i].board = malloc(sizeof(Board));
+    }
+
+    // Look at every position, then pass solved positions back until nothing changes
+    PositionList wave = {0}, solved = {0};
+    runPass(&gen, threads, threadCount, &wave);
+
+    int passes = 1;
+    while (wave.count) {
+        gen.wave = &wave;
+        runPass(&gen, threads, threadCount, &solved);
+
+        PositionList swap = wave;
+        wave = solved;
+        solved = swap;
+        passes++;
+    }
+
+    // Everything left is a draw
+    size_t counts[3] = {0};
+    bb->data = calloc((bb->positions + 3) / 4, 1);
+    bb->mapped = false;
+    for (size_t i = 0; i < bb->positions; i++) {
+        int state = atomic_load(&gen.states[i]);
+        if (state == GEN_INVALID)
+            continue;
+
+        int result = (state == GEN_WIN) ? BITBASE_WIN : (state == GEN_LOSS) ? BITBASE_LOSS : BITBASE_DRAW;
+        bb->data[i / 4] |= result << (2 * (i % 4));
+        counts[result]++;
+    }
+
+    char path[FILENAME_MAX];
+    snprintf(path, sizeof(path), "%s/%s.bb", directory, bb->name);
+    FILE *file = fopen(path, "wb");
+    if (file == NULL || fwrite(bb->data, 1, (bb->positions + 3) / 4, file) != (bb->positions + 3) / 4)
+        printf("Could not write %s\n", path);
+    if (file)
+        fclose(file);
+
+    printf("%-5s %9zu positions: %9zu won, %9zu drawn, %9zu lost, %3d passes in %d ms\n",
+           bb->name, counts[0] + counts[1] + counts[2], counts[BITBASE_WIN], counts[BITBASE_DRAW],
+           counts[BITBASE_LOSS], passes, getTime() - start);
+
+    for (int i = 0; i < threadCount; i++) {
+        free(threads[i].board);
+        free(threads[i].solved.items);
+    }
+    free(threads);
+    free(wave.items);
+    free(solved.items);
+    free(gen.states);
+    free(gen.moves);
+}
+
+// Generates every bitbase into a directory, and uses them straight away.
+void generateBitbases(const char *directory, int threads) {
+    if (threads <= 0)
+        threads = cpuCount();
+
+    int start = getTime();
+    bitbasePieces = 0;
+
+    for (int i = 0; i < BITBASE_COUNT; i++) {
+        unloadBitbase(&bitbases[i]);
+        generateBitbase(&bitbases[i], directory, threads);
+        bitbasePieces = MAX(bitbasePieces, bitbases[i].count + 2);
+    }
+
+    printf("Generated %d bitbases with %d threads in %d ms\n", BITBASE_COUNT, threads, getTime() - start);
+}
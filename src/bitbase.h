@@ -0,0 +1,44 @@
+// Endgame bitbases.
+//
+// Win, draw or loss for the side to move in every position of a few endgames
+// with up to 4 pieces: all 3 piece endgames, and the 4 piece endgames a queen
+// or rook has against a pawn (KQKP, KRKP) with the piece endgames they convert
+// into (KQKQ, KQKR, KQKB, KQKN, KRKR, KRKB, KRKN).
+//
+// They are generated by retrograde analysis. Every position is first looked at
+// with the move generator: captures and promotions lead to smaller endgames
+// which are already solved, mates and stalemates are solved on the spot, and
+// the rest count their moves which stay inside the endgame. Then results are
+// passed back to the positions before them, by undoing moves: a position
+// which can move into a lost one is won, and one whose moves all lead into won
+// ones is lost. Whatever is left once nothing changes is a draw.
+//
+// Positions are indexed by side to move and the square of each piece, with
+// the white king mirrored to one side of the board (and to the a1-d1-d4
+// triangle without pawns). Each endgame is stored as 2 bits per position in
+// its own file, e.g. KQKP.bb, which the engine memory maps. The other colors
+// (KPKQ) are probed by flipping the board.
+//
+// Usage: bitbases <directory> [threads]
+
+#pragma once
+
+#include "board.h"
+
+// Results, for the side to move
+enum {
+    BITBASE_DRAW,
+    BITBASE_WIN,
+    BITBASE_LOSS,
+    BITBASE_UNKNOWN
+};
+
+// Search score of known wins, on top of the evaluation so the search still makes progress
+#define BITBASE_WIN_SCORE 20000
+
+extern int bitbasePieces;
+
+void initBitbases();
+int loadBitbases(const char *directory);
+int probeBitbase(Board *board);
+void generateBitbases(const char *directory, int threads);
@@ -10,7 +10,10 @@
 #include "zobrist.h"
 #include "bitboards.h"
 #include "magicmoves.h"
+#include "sliders.h"
 #include "utils.h"
+#include "eval.h"
+#include "nnue.h"
 
 /* -------------------------------------------------------------------------- */
 /*                               Square helpers                               */
@@ -71,6 +74,16 @@ void setPiece(Board *board, int color, int piece, int sq) {
 
     // Update board hash
     board->hash ^= PieceKeys[toPiece(piece, color)][sq];
+    if (piece == PAWN)
+        board->pawnHash ^= PieceKeys[toPiece(piece, color)][sq];
+    board->materialKey += MATERIAL_KEY(toPiece(piece, color));
+
+    // Update material, PSQT and game phase
+    board->psqt += (color == WHITE) ? MATERIAL_PSQT[WHITE][piece][sq] : -MATERIAL_PSQT[BLACK][piece][sq];
+    board->phase += GAME_PHASE_INCREMENTS[piece];
+
+    // Record the change for the NNUE accumulator
+    accumulatorAddPiece(board, toPiece(piece, color), sq);
 }
 
 // Clears the piece from the board on the square specified
@@ -91,6 +104,16 @@ void clearPiece(Board *board, int color, int sq) {
 
     // Update board hash
     board->hash ^= PieceKeys[toPiece(piece, color)][sq];
+    if (piece == PAWN)
+        board->pawnHash ^= PieceKeys[toPiece(piece, color)][sq];
+    board->materialKey -= MATERIAL_KEY(toPiece(piece, color));
+
+    // Update material, PSQT and game phase
+    board->psqt -= (color == WHITE) ? MATERIAL_PSQT[WHITE][piece][sq] : -MATERIAL_PSQT[BLACK][piece][sq];
+    board->phase -= GAME_PHASE_INCREMENTS[piece];
+
+    // Record the change for the NNUE accumulator
+    accumulatorRemovePiece(board, toPiece(piece, color), sq);
 }
 
 // Moves piece from one square to on board
@@ -122,6 +145,20 @@ void movePiece(Board *board, int from, int to, int color) {
     // Update board hash
     board->hash ^= PieceKeys[toPiece(piece, color)][from];
     board->hash ^= PieceKeys[toPiece(piece, color)][to];
+    if (piece == PAWN) {
+        board->pawnHash ^= PieceKeys[toPiece(piece, color)][from];
+        board->pawnHash ^= PieceKeys[toPiece(piece, color)][to];
+    }
+
+    // Update PSQT, material and phase stay the same
+    if (color == WHITE)
+        board->psqt += MATERIAL_PSQT[WHITE][piece][to] - MATERIAL_PSQT[WHITE][piece][from];
+    else
+        board->psqt -= MATERIAL_PSQT[BLACK][piece][to] - MATERIAL_PSQT[BLACK][piece][from];
+
+    // Record the change for the NNUE accumulator
+    accumulatorRemovePiece(board, toPiece(piece, color), from);
+    accumulatorAddPiece(board, toPiece(piece, color), to);
 }
 
 // Clears the board to an empty state
@@ -137,21 +174,21 @@ void clearBoard(Board *board) {
     // Clear board variables
     board->side = BOTH;
     board->hash = 0ULL;
+    board->pawnHash = 0ULL;
+    board->materialKey = 0ULL;
     board->epSquare = NO_SQ;
     board->fiftyMove = 0;
     board->castlePerm = 0;
     board->hisPly = 0;
+    board->psqt = 0;
+    board->phase = 0;
+    resetAccumulators(board);
 
-    // Clear history
-    for (int i = 0; i < MAX_MOVES; i++) {
-        Undo *undo = &board->history[i];
-        undo->hash = 0ULL;
-        undo->castlePerm = 0;
-        undo->epSquare = NO_SQ;
-        undo->fiftyMove = 0;
-        undo->movedPiece = NO_PIECE;
-        undo->capturedPiece = NO_PIECE;
-    }
+    /**
+     * The undo history isn't cleared: makeMove writes an entry before anything
+     * reads it, and repetitions are only looked for back to hisPly 0. Clearing
+     * all MAX_MOVES entries was most of the time spent setting up a position.
+     */
 }
 
 /* -------------------------------------------------------------------------- */
@@ -192,8 +229,8 @@ U64 allAttackersToSquare(Board *board, U64 occupied, int sq) {
     return (pawnAttacks(WHITE, sq) & board->colors[BLACK] & board->pieces[PAWN])
         |  (pawnAttacks(BLACK, sq) & board->colors[WHITE] & board->pieces[PAWN])
         |  (knightAttacks(sq) & board->pieces[KNIGHT])
-        |  (Bmagic(sq, occupied) & (board->pieces[BISHOP] | board->pieces[QUEEN]))
-        |  (Rmagic(sq, occupied) & (board->pieces[ROOK] | board->pieces[QUEEN]))
+        |  (bishopAttacks(sq, occupied) & (board->pieces[BISHOP] | board->pieces[QUEEN]))
+        |  (rookAttacks(sq, occupied) & (board->pieces[ROOK] | board->pieces[QUEEN]))
         |  (kingAttacks(sq) & board->pieces[KING]);
 }
 
@@ -361,6 +398,55 @@ void printBoard(Board *board) {
     printf("\n *  a b c d e f g h  *\n\n");
 }
 
+// Writes the FEN of the board, the full move number is counted from hisPly.
+void boardToFen(Board *board, char *fen) {
+    const char pieceChars[] = "PNBRQKpnbrqk";
+
+    for (int rank = 7; rank >= 0; rank--) {
+        int empty = 0;
+        for (int file = 0; file < 8; file++) {
+            int sq = squareFrom(file, rank);
+            if (board->squares[sq] == EMPTY) {
+                empty++;
+                continue;
+            }
+
+            if (empty)
+                *fen++ = '0' + empty;
+            empty = 0;
+
+            int color = testBit(board->colors[WHITE], sq) ? WHITE : BLACK;
+            *fen++ = pieceChars[toPiece(board->squares[sq], color)];
+        }
+
+        if (empty)
+            *fen++ = '0' + empty;
+        if (rank > 0)
+            *fen++ = '/';
+    }
+
+    *fen++ = ' ';
+    *fen++ = (board->side == WHITE) ? 'w' : 'b';
+    *fen++ = ' ';
+
+    if (board->castlePerm == 0)
+        *fen++ = '-';
+    if (board->castlePerm & CASTLE_WK) *fen++ = 'K';
+    if (board->castlePerm & CASTLE_WQ) *fen++ = 'Q';
+    if (board->castlePerm & CASTLE_BK) *fen++ = 'k';
+    if (board->castlePerm & CASTLE_BQ) *fen++ = 'q';
+    *fen++ = ' ';
+
+    if (board->epSquare == NO_SQ) {
+        *fen++ = '-';
+    } else {
+        squareToString(board->epSquare, fen);
+        fen += 2;
+    }
+
+    sprintf(fen, " %d %d", board->fiftyMove, 1 + board->hisPly / 2);
+}
+
 // Sets a provided board to the provided FEN
 void parseFen(Board *board, char *fen) {
     int sq;
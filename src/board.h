@@ -1,6 +1,7 @@
 #pragma once
 
 #include <stdbool.h>
+#include <stdint.h>
 
 #include "bitboards.h"
 #include "move.h"
@@ -62,6 +63,9 @@ enum {
 
 #define MAX_MOVES 2048
 
+// Material key increment for a colored piece, each piece count gets 4 bits
+#define MATERIAL_KEY(coloredPiece) (1ULL << (4 * (coloredPiece)))
+
 enum { WHITE, BLACK, BOTH };
 
 // Hard to recompute information for undoing moves
@@ -74,8 +78,32 @@ typedef struct {
     Move move;
 
     U64 hash;
+    U64 pawnHash;
+    U64 materialKey;
+    int psqt;
+    int phase;
 } Undo;
 
+/**
+ * NNUE accumulators, one per position in the game (indexed by hisPly) kept in
+ * a ring buffer. Moves only record which pieces were added and removed, the
+ * accumulator itself is computed lazily from the last computed one when the
+ * position is actually evaluated. See nnue.h for the network itself.
+ */
+#define NNUE_HIDDEN 256
+#define ACCUMULATOR_STACK_SIZE 128
+
+typedef struct {
+    _Alignas(32) int16_t values[2][NNUE_HIDDEN]; // Hidden layer for each perspective
+    int ply;              // hisPly this entry was written for, to detect wrapping
+    bool computed;
+    bool needsRefresh;    // Delta is unusable (e.g. after parsing a fen)
+    int8_t addedCount;
+    int8_t removedCount;
+    uint16_t added[2];    // Added pieces as (colored piece * 64 + square)
+    uint16_t removed[2];  // Removed pieces as (colored piece * 64 + square)
+} Accumulator;
+
 // Chess Board Representation
 typedef struct {
     U64 colors[3];           // Occupancies for colors WHITE, BLACK and BOTH
@@ -89,8 +117,13 @@ typedef struct {
     int hisPly;              // Half moves since start of game, index of repetition table
 
     U64 hash;                // Zobrist hash
+    U64 pawnHash;            // Zobrist hash of only the pawns, for the pawn hash table
+    U64 materialKey;         // Piece counts, for the material table (see material.h)
+    int psqt;                // Packed material + PSQT score from White's POV
+    int phase;               // Unclamped game phase, see GAME_PHASE_INCREMENTS
 
     Undo history[MAX_MOVES]; // List of possible undos to past positions
+    Accumulator accumulators[ACCUMULATOR_STACK_SIZE]; // NNUE accumulator ring buffer
 } Board;
 
 
@@ -123,4 +156,5 @@ bool nullMoveIsBad(Board *board);
 
 // Board IO
 void parseFen(Board *board, char *fen);
+void boardToFen(Board *board, char *fen);
 void printBoard(Board *board);
@@ -0,0 +1,177 @@
+#include <stdio.h>
+
+#include "book.h"
+#include "board.h"
+#include "makemove.h"
+#include "movegen.h"
+#include "utils.h"
+#include "zobrist.h"
+
+// Play the highest weighted move instead of a random one
+bool bookBestMove = false;
+
+static const uint8_t *bookData = NULL;
+static size_t bookSize = 0;
+static size_t bookEntries = 0;
+
+static U64 readBigEndian(const uint8_t *in, int bytes) {
+    U64 value = 0;
+    for (int i = 0; i < bytes; i++)
+        value = (value << 8) | in[i];
+    return value;
+}
+
+static void readEntry(size_t index, BookEntry *entry) {
+    const uint8_t *in = bookData + index * BOOK_ENTRY_SIZE;
+    entry->key = readBigEndian(in, 8);
+    entry->move = readBigEndian(in + 8, 2);
+    entry->weight = readBigEndian(in + 10, 2);
+    entry->learn = readBigEndian(in + 12, 4);
+}
+
+static void writeBigEndian(uint8_t *out, U64 value, int bytes) {
+    for (int i = bytes - 1; i >= 0; i--, value >>= 8)
+        out[i] = value & 0xFF;
+}
+
+// Encodes an entry as it is stored in a book file.
+void encodeBookEntry(const BookEntry *entry, uint8_t *out) {
+    writeBigEndian(out, entry->key, 8);
+    writeBigEndian(out + 8, entry->move, 2);
+    writeBigEndian(out + 10, entry->weight, 2);
+    writeBigEndian(out + 12, entry->learn, 4);
+}
+
+// Maps a book, replacing the current one. False if it can't be read.
+bool openBook(const char *path) {
+    closeBook();
+
+    size_t size;
+    const char *data = mapFile(path, &size);
+    if (data == NULL)
+        return false;
+
+    if (size % BOOK_ENTRY_SIZE != 0) {
+        unmapFile(data, size);
+        return false;
+    }
+
+    bookData = (const uint8_t *) data;
+    bookSize = size;
+    bookEntries = size / BOOK_ENTRY_SIZE;
+    return true;
+}
+
+void closeBook() {
+    if (bookData != NULL)
+        unmapFile((const char *) bookData, bookSize);
+
+    bookData = NULL;
+    bookSize = 0;
+    bookEntries = 0;
+}
+
+bool bookIsOpen() {
+    return bookData != NULL;
+}
+
+// Converts a book move to our move in this position, NO_MOVE if it isn't legal.
+Move bookToMove(Board *board, uint16_t bookMove) {
+    int to = bookMove & 0x3F;
+    int from = (bookMove >> 6) & 0x3F;
+    int promoted = (bookMove >> 12) & 0x7;
+
+    // Castling is stored as the king moving onto its rook
+    bool castling = board->squares[from] == KING && board->squares[to] == ROOK
+                 && testBit(board->colors[board->side], to);
+    if (castling)
+        to = squareFrom(fileOf(to) > fileOf(from) ? 6 : 2, rankOf(from));
+
+    MoveList moves;
+    generatePseudoLegalMoves(&moves, board);
+
+    for (int i = 0; i < moves.count; i++) {
+        Move move = moves.list[i];
+        if (MoveFrom(move) != from || MoveTo(move) != to || IsCastling(move) != castling)
+            continue;
+        if (IsPromotion(move) ? MovePromotedPiece(move) != promoted : promoted != 0)
+            continue;
+
+        int legal = makeMove(board, move);
+        undoMove(board, move);
+        return legal ? move : NO_MOVE;
+    }
+
+    return NO_MOVE;
+}
+
+// Converts our move to a book move.
+uint16_t moveToBook(Move move) {
+    int from = MoveFrom(move);
+    int to = MoveTo(move);
+    int promoted = IsPromotion(move) ? MovePromotedPiece(move) : 0;
+
+    if (IsCastling(move))
+        to = squareFrom(fileOf(to) == 6 ? 7 : 0, rankOf(from));
+
+    return to | (from << 6) | (promoted << 12);
+}
+
+/**
+ * Picks a book move for the position, NO_MOVE if the position isn't in the
+ * book. Moves with a weight of 0 are never played.
+ */
+Move probeBook(Board *board) {
+    if (bookData == NULL)
+        return NO_MOVE;
+
+    U64 key = polyglotKey(board);
+
+    // First entry with the key
+    size_t low = 0, high = bookEntries;
+    while (low < high) {
+        size_t mid = low + (high - low) / 2;
+        if (readBigEndian(bookData + mid * BOOK_ENTRY_SIZE, 8) < key)
+            low = mid + 1;
+        else
+            high = mid;
+    }
+
+    Move moves[MAX_LEGAL_MOVES];
+    int weights[MAX_LEGAL_MOVES];
+    int count = 0, total = 0;
+
+    BookEntry entry;
+    for (size_t i = low; i < bookEntries && count < MAX_LEGAL_MOVES; i++) {
+        readEntry(i, &entry);
+        if (entry.key != key)
+            break;
+
+        // Skip illegal moves, in case of a key collision
+        Move move = bookToMove(board, entry.move);
+        if (move == NO_MOVE || entry.weight == 0)
+            continue;
+
+        moves[count] = move;
+        weights[count] = entry.weight;
+        total += entry.weight;
+        count++;
+    }
+
+    if (count == 0)
+        return NO_MOVE;
+
+    int best = 0;
+    if (bookBestMove) {
+        for (int i = 1; i < count; i++) {
+            if (weights[i] > weights[best])
+                best = i;
+        }
+    } else {
+        int pick = randomU64() % total;
+        while (pick >= weights[best])
+            pick -= weights[best++];
+    }
+
+    return moves[best];
+}
@@ -0,0 +1,47 @@
+// Polyglot opening book probing.
+//
+// A book is a memory mapped file of 16 byte entries sorted by key, all values
+// big endian:
+//
+//   key          book key of the position, see polyglotKey in zobrist.h
+//   move         to square (6 bits), from square (6 bits) and promoted piece
+//                (3 bits, 1 knight to 4 queen). Castling is the king taking
+//                its own rook, e.g. e1h1
+//   weight       how good the move is, e.g. from the number of games it won
+//   learn        unused
+//
+// The moves of a position are found with a binary search for its key, and
+// one is picked at random in proportion to the weights, or the one with the
+// highest weight if BookBestMove is set.
+
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "board.h"
+#include "move.h"
+
+#define BOOK_ENTRY_SIZE 16
+
+typedef struct {
+    U64 key;
+    uint16_t move;
+    uint16_t weight;
+    uint32_t learn;
+} BookEntry;
+
+extern bool bookBestMove;
+
+bool openBook(const char *path);
+void closeBook();
+bool bookIsOpen();
+
+Move probeBook(Board *board);
+
+void encodeBookEntry(const BookEntry *entry, uint8_t *out);
+
+// Conversion between our moves and book moves
+Move bookToMove(Board *board, uint16_t bookMove);
+uint16_t moveToBook(Move move);
@@ -0,0 +1,158 @@
+#include <assert.h>
+#include <string.h>
+
+#include "chain.h"
+#include "board.h"
+#include "makemove.h"
+#include "packed.h"
+
+// Longest a varint score can get, for 32 bit scores
+#define CHAIN_MAX_VARINT 5
+
+// Games are cut short before hisPly gets anywhere near MAX_MOVES
+#define CHAIN_MAX_PLIES (MAX_MOVES / 2)
+
+static inline void write16(uint8_t *out, int value) {
+    out[0] = value & 0xFF;
+    out[1] = (value >> 8) & 0xFF;
+}
+
+static inline int read16(const uint8_t *in) {
+    return in[0] | (in[1] << 8);
+}
+
+/* -------------------------------------------------------------------------- */
+/*                                   Writing                                  */
+/* -------------------------------------------------------------------------- */
+
+// Starts a new game from the current position.
+void chainBegin(ChainGame *game, Board *board) {
+    packBoard(board, 0, PACKED_DRAW, &game->start);
+    game->plies = 0;
+    game->positions = 0;
+    game->lastScore = 0;
+    game->size = 0;
+}
+
+/**
+ * Adds the move played from the current position, with the position's score
+ * or CHAIN_NO_SCORE to leave it out. Returns false if the game is too long to
+ * add any more moves, the game can still be written.
+ */
+bool chainAddMove(ChainGame *game, Move move, int score) {
+    if (game->plies >= CHAIN_MAX_PLIES || game->size + 2 + CHAIN_MAX_VARINT > CHAIN_MAX_BYTES)
+        return false;
+
+    write16(&game->moves[game->size], move);
+    game->size += 2;
+
+    // Scores of consecutive positions are close, so store the difference with zigzag encoding
+    uint32_t value = 0;
+    if (score != CHAIN_NO_SCORE) {
+        int delta = score - game->lastScore;
+        value = ((uint32_t) delta << 1 ^ (uint32_t) (delta >> 31)) + 1;
+        game->lastScore = score;
+        game->positions++;
+    }
+
+    do {
+        game->moves[game->size++] = (value & 0x7F) | (value > 0x7F ? 0x80 : 0);
+        value >>= 7;
+    } while (value);
+
+    game->plies++;
+    return true;
+}
+
+// Sets the result and the header, after which the game can be written or read back.
+void chainFinish(ChainGame *game, int result) {
+    game->start.result = result;
+    write16(game->header, game->plies);
+    write16(game->header + 2, game->size);
+}
+
+// Writes a finished game, returns the number of bytes written.
+size_t chainWrite(ChainGame *game, FILE *file) {
+    return fwrite(game, 1, CHAIN_HEADER_SIZE + game->size, file);
+}
+
+/* -------------------------------------------------------------------------- */
+/*                                   Reading                                  */
+/* -------------------------------------------------------------------------- */
+
+// Size of the game starting at data, so games can be skipped without reading them.
+size_t chainGameSize(const uint8_t *data) {
+    return CHAIN_HEADER_SIZE + read16(data + sizeof(PackedBoard) + 2);
+}
+
+void chainReaderInit(ChainReader *reader, const uint8_t *data, size_t size) {
+    reader->data = data;
+    reader->end = data + size;
+    reader->moves = NULL;
+    reader->pliesLeft = 0;
+    reader->lastScore = 0;
+    reader->result = PACKED_DRAW;
+    reader->pendingMove = NO_MOVE;
+}
+
+/**
+ * Sets the board to the next position with a score, false at the end of the
+ * data. The board must not be changed between calls (or be changed back), as
+ * the next position is found by playing moves on it.
+ */
+bool chainReaderNext(ChainReader *reader, Board *board, int *score, int *result) {
+    while (true) {
+        // Start the next game once this one is out of moves
+        if (reader->pliesLeft == 0) {
+            if (reader->data + CHAIN_HEADER_SIZE > reader->end)
+                return false;
+
+            // Games don't start on aligned addresses
+            PackedBoard start;
+            memcpy(&start, reader->data, sizeof(PackedBoard));
+            unpackBoard(&start, board);
+
+            reader->pliesLeft = read16(reader->data + sizeof(PackedBoard));
+            reader->moves = reader->data + CHAIN_HEADER_SIZE;
+            reader->data += chainGameSize(reader->data);
+            reader->lastScore = 0;
+            reader->result = start.result;
+            reader->pendingMove = NO_MOVE;
+
+            // Truncated file
+            if (reader->data > reader->end)
+                return false;
+
+            continue;
+        }
+
+        if (reader->pendingMove != NO_MOVE) {
+            int legal = makeMove(board, reader->pendingMove);
+            assert(legal);
+            (void) legal;
+        }
+
+        Move move = read16(reader->moves);
+        reader->moves += 2;
+
+        uint32_t value = 0;
+        for (int shift = 0; ; shift += 7) {
+            uint8_t byte = *reader->moves++;
+            value |= (uint32_t) (byte & 0x7F) << shift;
+            if (!(byte & 0x80))
+                break;
+        }
+
+        reader->pliesLeft--;
+        reader->pendingMove = move;
+
+        if (value == 0)
+            continue;
+
+        value--;
+        reader->lastScore += (int) (value >> 1) ^ -(int) (value & 1);
+        *score = reader->lastScore;
+        *result = reader->result;
+        return true;
+    }
+}
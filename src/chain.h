@@ -0,0 +1,74 @@
+// Chained game format for training data.
+//
+// Consecutive positions of a game only differ by one move, so instead of
+// packing every position on its own, a game is stored as its start position
+// and the moves played from it:
+//
+//   start        packed start position (see packed.h), with the game result
+//   plies        number of moves, 16 bits
+//   bytes        size of the move data below, 16 bits
+//   moves        for each ply, the move (16 bits) and a varint score:
+//                0 if the position before the move isn't part of the data
+//                (e.g. it isn't quiet), otherwise the zigzag encoded change
+//                from the last stored score plus one
+//
+// This takes around 4.7 bytes per position instead of 32, counting the game
+// headers and the plies without a score. Positions are read back by playing
+// the moves with makeMove, one game at a time, so reading only needs a board
+// and the (memory mapped) file.
+
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#include "board.h"
+#include "move.h"
+#include "packed.h"
+
+// Most bytes a game's move data can take
+#define CHAIN_MAX_BYTES 65535
+
+// Score of positions which aren't part of the data
+#define CHAIN_NO_SCORE INT16_MIN
+
+// A game being written, laid out like it is in the file up to the move data
+typedef struct {
+    PackedBoard start;
+    uint8_t header[4];        // Ply count and size of the move data, set by chainFinish
+    uint8_t moves[CHAIN_MAX_BYTES];
+
+    int plies;
+    int positions;            // Plies with a score
+    int lastScore;
+    size_t size;
+} ChainGame;
+
+// Start position, ply count and move data size
+#define CHAIN_HEADER_SIZE (sizeof(PackedBoard) + 4)
+
+_Static_assert(offsetof(ChainGame, moves) == CHAIN_HEADER_SIZE, "ChainGame should match the file layout");
+
+// Streaming reader over a buffer of chained games
+typedef struct {
+    const uint8_t *data;
+    const uint8_t *end;
+    const uint8_t *moves;     // Next ply of the current game
+    int pliesLeft;
+    int lastScore;
+    int result;
+    Move pendingMove;         // Move to play before reading the next ply
+} ChainReader;
+
+// Writing
+void chainBegin(ChainGame *game, Board *board);
+bool chainAddMove(ChainGame *game, Move move, int score);
+void chainFinish(ChainGame *game, int result);
+size_t chainWrite(ChainGame *game, FILE *file);
+
+// Reading
+size_t chainGameSize(const uint8_t *data);
+void chainReaderInit(ChainReader *reader, const uint8_t *data, size_t size);
+bool chainReaderNext(ChainReader *reader, Board *board, int *score, int *result);
@@ -0,0 +1,282 @@
+#include <inttypes.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "datagen.h"
+#include "board.h"
+#include "chain.h"
+#include "hashtable.h"
+#include "makemove.h"
+#include "movegen.h"
+#include "packed.h"
+#include "search.h"
+#include "uci.h"
+#include "utils.h"
+
+// Hash size of each thread, only a few thousand nodes are searched per move
+#define DATAGEN_HASH_MB 16
+
+// Random moves played from the start position, before the engine takes over
+#define DATAGEN_RANDOM_PLIES 8
+
+// Openings which are already lost after the random moves are thrown away
+#define DATAGEN_OPENING_SCORE 1000
+
+// Win adjudication: both sides agree the game is won for a few moves
+#define DATAGEN_WIN_SCORE 2000
+#define DATAGEN_WIN_PLIES 4
+
+// Draw adjudication: the score stays around 0 for a while after the opening
+#define DATAGEN_DRAW_PLY 80
+#define DATAGEN_DRAW_SCORE 10
+#define DATAGEN_DRAW_PLIES 10
+
+// Games which get this long are drawn, this also keeps hisPly far from MAX_MOVES
+#define DATAGEN_MAX_PLIES 500
+
+// How often to print the progress
+#define DATAGEN_REPORT_POSITIONS 100000
+
+/**
+ * State shared by the datagen threads. Threads only take the lock to write a
+ * finished game, which is rare compared to the searches in between.
+ */
+typedef struct {
+    FILE *file;
+    pthread_mutex_t lock;
+    uint64_t target;
+    uint64_t positions;
+    uint64_t games;
+    uint64_t nextReport;
+    uint64_t bytes;           // Written in the chained format
+    bool chained;
+    int nodes;
+    int start;
+} Datagen;
+
+typedef struct {
+    Datagen *datagen;
+    uint64_t seed;
+} DatagenThread;
+
+// Xorshift like randomU64, with a seed per thread.
+static uint64_t nextRandom(uint64_t *seed) {
+    *seed ^= *seed >> 12;
+    *seed ^= *seed << 25;
+    *seed ^= *seed >> 27;
+    return *seed * 0x2545F4914F6CDD1DULL;
+}
+
+// Fills the list with the legal moves of the position.
+static void legalMoves(Board *board, MoveList *legal) {
+    MoveList moves;
+    generatePseudoLegalMoves(&moves, board);
+
+    legal->count = 0;
+    for (int i = 0; i < moves.count; i++) {
+        if (makeMove(board, moves.list[i]))
+            legal->list[legal->count++] = moves.list[i];
+        undoMove(board, moves.list[i]);
+    }
+}
+
+// Plays random moves from the start position, false if the game ended during them.
+static bool randomOpening(Board *board, uint64_t *seed) {
+    parseFen(board, START_FEN);
+
+    // An odd number of plies now and then, so both sides get to start
+    int plies = DATAGEN_RANDOM_PLIES + (nextRandom(seed) & 1);
+    MoveList moves;
+
+    for (int ply = 0; ply < plies; ply++) {
+        legalMoves(board, &moves);
+        if (moves.count == 0)
+            return false;
+
+        makeMove(board, moves.list[nextRandom(seed) % moves.count]);
+    }
+
+    legalMoves(board, &moves);
+    return moves.count > 0;
+}
+
+/**
+ * Plays one game, recording its moves and the scores of its quiet positions.
+ * Returns the number of positions, or 0 if the game should be thrown away.
+ */
+static int playGame(Engine *engine, Datagen *datagen, uint64_t *seed, ChainGame *game) {
+    Board *board = &engine->board;
+    initEngine(engine);
+    engine->silent = true;
+    engine->pollInput = false;
+
+    if (!randomOpening(board, seed))
+        return 0;
+
+    chainBegin(game, board);
+
+    SearchLimits limits = {0};
+    limits.depth = MAX_DEPTH - 1;
+    limits.nodes = datagen->nodes;
+    limits.searchType = LIMIT_NODES;
+
+    int winPlies = 0, drawPlies = 0;
+    int result = PACKED_DRAW;
+
+    for (int ply = 0; ; ply++) {
+        MoveList moves;
+        legalMoves(board, &moves);
+
+        // Checkmate or stalemate
+        if (moves.count == 0) {
+            if (boardIsInCheck(board))
+                result = (board->side == WHITE) ? PACKED_LOSS : PACKED_WIN;
+            break;
+        }
+
+        if (isDraw(board, 0) || board->hisPly >= DATAGEN_MAX_PLIES)
+            break;
+
+        initSearch(engine, limits);
+        Move move = iterativeDeepening(engine);
+        int score = engine->searchStats.score;
+        int whiteScore = (board->side == WHITE) ? score : -score;
+
+        if (ply == 0 && abs(score) >= DATAGEN_OPENING_SCORE)
+            return 0;
+
+        // Adjudicate found mates and won positions, counting plies won for White up and Black down
+        if (whiteScore >= DATAGEN_WIN_SCORE)
+            winPlies = MAX(winPlies, 0) + 1;
+        else if (whiteScore <= -DATAGEN_WIN_SCORE)
+            winPlies = MIN(winPlies, 0) - 1;
+        else
+            winPlies = 0;
+
+        if (isMateScore(score) || abs(winPlies) >= DATAGEN_WIN_PLIES) {
+            result = (whiteScore > 0) ? PACKED_WIN : PACKED_LOSS;
+            break;
+        }
+
+        // Adjudicate dead draws
+        drawPlies = (ply >= DATAGEN_DRAW_PLY && abs(score) <= DATAGEN_DRAW_SCORE) ? drawPlies + 1 : 0;
+        if (drawPlies >= DATAGEN_DRAW_PLIES)
+            break;
+
+        // Only keep quiet positions, the score of noisy ones depends on the tactics
+        bool quiet = !boardIsInCheck(board) && !IsCapture(move) && !IsPromotion(move);
+        if (!chainAddMove(game, move, quiet ? whiteScore : CHAIN_NO_SCORE))
+            break;
+
+        makeMove(board, move);
+    }
+
+    chainFinish(game, result);
+    return game->positions;
+}
+
+// Writes a finished game as separate packed positions, by reading the chain back.
+static void writePacked(ChainGame *game, FILE *file, Board *board) {
+    ChainReader reader;
+    chainReaderInit(&reader, (const uint8_t *) game, CHAIN_HEADER_SIZE + game->size);
+
+    int startSide = game->start.sideEp >> 7;
+    int score, result;
+    while (chainReaderNext(&reader, board, &score, &result)) {
+        PackedBoard packed;
+        packBoard(board, score, result, &packed);
+        packed.fullMove = game->start.fullMove + (board->hisPly + startSide) / 2;
+        fwrite(&packed, sizeof(PackedBoard), 1, file);
+    }
+}
+
+// Datagen thread, plays games until enough positions were written.
+static void *datagenThread(void *arg) {
+    DatagenThread *thread = arg;
+    Datagen *datagen = thread->datagen;
+
+    // The hash table and histories are per thread, and this one doesn't have them yet
+    initHashTable(DATAGEN_HASH_MB);
+    Engine *engine = malloc(sizeof(Engine));
+    ChainGame *game = malloc(sizeof(ChainGame));
+    Board *board = malloc(sizeof(Board));
+
+    bool done = false;
+    while (!done) {
+        int count = playGame(engine, datagen, &thread->seed, game);
+
+        pthread_mutex_lock(&datagen->lock);
+        if (count > 0 && datagen->positions < datagen->target) {
+            if (datagen->chained)
+                datagen->bytes += chainWrite(game, datagen->file);
+            else
+                writePacked(game, datagen->file, board);
+
+            datagen->positions += count;
+            datagen->games++;
+        }
+
+        if (datagen->positions >= datagen->nextReport) {
+            int elapsed = MAX(getTime() - datagen->start, 1);
+            printf("%" PRIu64 " positions from %" PRIu64 " games, %.0f positions/s\n",
+                   datagen->positions, datagen->games, datagen->positions * 1000.0 / elapsed);
+            fflush(stdout);
+            datagen->nextReport += DATAGEN_REPORT_POSITIONS;
+        }
+
+        done = datagen->positions >= datagen->target;
+        pthread_mutex_unlock(&datagen->lock);
+    }
+
+    free(board);
+    free(game);
+    free(engine);
+    cleanUpHashTable();
+    return NULL;
+}
+
+// Generates self-play training data, see datagen.h.
+void datagen(const char *path, uint64_t positions, int nodes, int threads) {
+    Datagen datagen = {0};
+    datagen.file = fopen(path, "ab");
+    if (datagen.file == NULL) {
+        printf("Could not open %s\n", path);
+        return;
+    }
+
+    if (threads <= 0)
+        threads = cpuCount();
+
+    pthread_mutex_init(&datagen.lock, NULL);
+    datagen.chained = hasExtension(path, ".chain");
+    datagen.target = positions;
+    datagen.nodes = nodes;
+    datagen.nextReport = DATAGEN_REPORT_POSITIONS;
+    datagen.start = getTime();
+
+    printf("Generating %" PRIu64 " positions at %d nodes per move with %d threads into %s\n",
+           positions, nodes, threads, path);
+
+    pthread_t *handles = malloc(threads * sizeof(pthread_t));
+    DatagenThread *workers = malloc(threads * sizeof(DatagenThread));
+    for (int i = 0; i < threads; i++) {
+        workers[i].datagen = &datagen;
+        workers[i].seed = ((uint64_t) getTime() << 16) ^ ((i + 1) * 0x9E3779B97F4A7C15ULL);
+        pthread_create(&handles[i], NULL, datagenThread, &workers[i]);
+    }
+
+    for (int i = 0; i < threads; i++)
+        pthread_join(handles[i], NULL);
+
+    int elapsed = MAX(getTime() - datagen.start, 1);
+    printf("Wrote %" PRIu64 " positions from %" PRIu64 " games in %d s, %.0f positions/s\n",
+           datagen.positions, datagen.games, elapsed / 1000, datagen.positions * 1000.0 / elapsed);
+    if (datagen.chained)
+        printf("Chained games take %.2f bytes per position\n", (double) datagen.bytes / MAX(datagen.positions, 1));
+
+    free(handles);
+    free(workers);
+    pthread_mutex_destroy(&datagen.lock);
+    fclose(datagen.file);
+}
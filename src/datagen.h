@@ -0,0 +1,22 @@
+// Self-play training data generation.
+//
+// Plays games against itself at a fixed number of nodes per move on every
+// core, starting from a few random moves so games don't repeat. Games are
+// adjudicated once the score is decisive for a few moves, or drawn for long
+// enough. Quiet positions (not in check, and the best move isn't a capture or
+// promotion) are written with the search score and the game result as packed
+// positions (see packed.h), or as whole games in the chained format if the
+// output ends in .chain (see chain.h).
+//
+// Usage: datagen <output> [positions] [nodes] [threads]
+// Threads default to the number of cores. Positions are appended to the output
+// file, so runs can be stopped and continued.
+
+#pragma once
+
+#include <stdint.h>
+
+#define DATAGEN_DEFAULT_POSITIONS 1000000
+#define DATAGEN_DEFAULT_NODES 5000
+
+void datagen(const char *path, uint64_t positions, int nodes, int threads);
@@ -1,11 +1,16 @@
 #include <assert.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 
 #include "eval.h"
 #include "board.h"
 #include "bitboards.h"
 #include "magicmoves.h"
+#include "material.h"
+#include "sliders.h"
+#include "nnue.h"
+#include "utils.h"
 
 
 /* -------------------------------------------------------------------------- */
@@ -19,9 +24,18 @@
  * evaluation discontinuity. This value starts at 24, and lowers to zero by the
  * time a pawn endgame is reached.
  * 
- * TODO: maybe do phase incrementally
+ * The phase is updated incrementally by the board as pieces come and go, so
+ * all that's left to do here is clamp it.
  */
 int getGamePhase(Board *board) {
+    assert(board->phase == computeGamePhase(board));
+
+    // Clamp phase in case someone promotes early.
+    return (board->phase > PHASE_MAX) ? PHASE_MAX : board->phase;
+}
+
+// Unclamped game phase computed from scratch, used to verify the board's copy.
+int computeGamePhase(Board *board) {
     int phase = 0;
 
     // Loop through all pieces which affect game phase.
@@ -29,9 +43,7 @@ int getGamePhase(Board *board) {
         // Increment the phase by how many pieces of that type is on the board.
         phase += popCount(board->pieces[piece]) * GAME_PHASE_INCREMENTS[piece];
     }
-    
-    // Clamp phase in case someone promotes early.
-    if (phase > PHASE_MAX) phase = PHASE_MAX;
+
     return phase;
 }
 
@@ -48,50 +60,261 @@ int taper(int score, int phase) {
 /*                              Piece Evaluation                              */
 /* -------------------------------------------------------------------------- */
 
-// Combination of material and piece square tables in one place.
-static int MATERIAL_PSQT[2][NB_PIECES][64];
+/**
+ * Combination of material and piece square tables in one place. Material and
+ * PSQT are summed incrementally into board->psqt as pieces move, so the piece
+ * evaluation functions below only cover the terms that can't be updated that way.
+ */
+int MATERIAL_PSQT[2][NB_PIECES][64];
 
-// Evaluates how well placed the pawns are for this color.
-int evaluatePawns(Board *board, int color) {
+// Material + PSQT of all pieces of one type and color.
+int evaluateMaterialPsqt(Board *board, int piece, int color) {
     int score = 0;
-    U64 pawns = board->pieces[PAWN] & board->colors[color];
-    
-    // Loop through all the pawns of this side
-    while (pawns) {
-        int square = poplsb(&pawns);
-        
-        // Material + PSQT
-        score += MATERIAL_PSQT[color][PAWN][square];
+    U64 pieces = board->pieces[piece] & board->colors[color];
 
-        /** TODO: pawn structure goes here */
+    while (pieces) {
+        int square = poplsb(&pieces);
+        score += MATERIAL_PSQT[color][piece][square];
     }
 
     return score;
 }
 
-// Evaluates how well placed the knights are for this color.
-int evaluateKnights(Board *board, int color) {
+// Material + PSQT from White's POV computed from scratch, used to verify board->psqt.
+int computeMaterialPsqt(Board *board) {
     int score = 0;
-    U64 knights = board->pieces[KNIGHT] & board->colors[color];
-    
-    // Loop through all the knights of this side
-    while (knights) {
-        int square = poplsb(&knights);
-        
-        // Material + PSQT
-        score += MATERIAL_PSQT[color][KNIGHT][square];
 
-        // Mobility
-        int count = popCount(knightAttacks(square));
-        score += count * MOBILITY_VALUES[KNIGHT];
+    for (int piece = PAWN; piece <= KING; piece++)
+        score += evaluateMaterialPsqt(board, piece, WHITE) - evaluateMaterialPsqt(board, piece, BLACK);
+
+    return score;
+}
+
+/* -------------------------------------------------------------------------- */
+/*                               Pawn Structure                               */
+/* -------------------------------------------------------------------------- */
+
+#define FILE_A_BB 0x0101010101010101ULL
+#define FILE_H_BB 0x8080808080808080ULL
+
+// Setwise helpers, see https://www.chessprogramming.org/Pawn_Fills
+static inline U64 northFill(U64 b) {
+    b |= b << 8;
+    b |= b << 16;
+    b |= b << 32;
+    return b;
+}
+
+static inline U64 southFill(U64 b) {
+    b |= b >> 8;
+    b |= b >> 16;
+    b |= b >> 32;
+    return b;
+}
+
+static inline U64 eastOne(U64 b) { return (b << 1) & ~FILE_A_BB; }
+static inline U64 westOne(U64 b) { return (b >> 1) & ~FILE_H_BB; }
+
+// Pushes pawns one square forward for this color.
+static inline U64 pawnPush(U64 pawns, int color) {
+    return (color == WHITE) ? pawns << 8 : pawns >> 8;
+}
+
+// All squares in front of the pawns for this color.
+static inline U64 frontSpan(U64 pawns, int color) {
+    return (color == WHITE) ? northFill(pawns << 8) : southFill(pawns >> 8);
+}
+
+// All squares attacked by the pawns for this color.
+static inline U64 pawnAttacksSetwise(U64 pawns, int color) {
+    U64 pushed = pawnPush(pawns, color);
+    return eastOne(pushed) | westOne(pushed);
+}
+
+// Evaluates the pawn structure for this color.
+int evaluatePawns(Board *board, int color) {
+    int score = 0;
+    U64 ours = board->pieces[PAWN] & board->colors[color];
+    U64 theirs = board->pieces[PAWN] & board->colors[!color];
+
+    // Passed pawns, with no enemy pawns in front on the same or adjacent files
+    U64 theirSpan = frontSpan(theirs, !color);
+    U64 passed = ours & ~(theirSpan | eastOne(theirSpan) | westOne(theirSpan));
+    while (passed) {
+        int square = poplsb(&passed);
+        int relativeRank = (color == WHITE) ? rankOf(square) : 7 - rankOf(square);
+        score += PASSED_PAWN_VALUES[relativeRank];
     }
 
+    // Isolated pawns, with no friendly pawns on adjacent files
+    U64 files = northFill(ours) | southFill(ours);
+    U64 isolated = ours & ~(eastOne(files) | westOne(files));
+    score += popCount(isolated) * ISOLATED_PAWN_VALUE;
+
+    // Doubled pawns, counted once for each pawn stuck behind a friendly pawn
+    U64 doubled = ours & frontSpan(ours, !color);
+    score += popCount(doubled) * DOUBLED_PAWN_VALUE;
+
+    // Backward pawns, whose stop square is attacked by an enemy pawn and can't
+    // ever be defended by a friendly pawn
+    U64 ourAttackSpan = pawnAttacksSetwise(ours, color);
+    ourAttackSpan |= frontSpan(ourAttackSpan, color);
+    U64 badStops = pawnPush(ours, color) & pawnAttacksSetwise(theirs, !color) & ~ourAttackSpan;
+    U64 backward = ours & pawnPush(badStops, !color);
+    score += popCount(backward) * BACKWARD_PAWN_VALUE;
+
     return score;
 }
 
+/* -------------------------------------------------------------------------- */
+/*                               Pawn Hash Table                              */
+/* -------------------------------------------------------------------------- */
+
+/**
+ * The pawn structure changes rarely during search, so its evaluation is cached
+ * in a small table keyed by the board's pawn hash. Almost every probe hits, so
+ * the pawn structure costs about as much as a single memory access.
+ * https://www.chessprogramming.org/Pawn_Hash_Table
+ */
+#define PAWN_TABLE_SIZE (1 << 14)
+
+typedef struct {
+    U64 pawnHash;
+    int score;
+} PawnEntry;
+
+static _Thread_local PawnEntry pawnTable[PAWN_TABLE_SIZE];
+static _Thread_local U64 pawnTableProbes = 0;
+static _Thread_local U64 pawnTableHits = 0;
+
+// Pawn structure evaluation from White's POV, through the pawn hash table.
+int evaluatePawnStructure(Board *board) {
+    PawnEntry *entry = &pawnTable[board->pawnHash % PAWN_TABLE_SIZE];
+
+    pawnTableProbes++;
+    if (entry->pawnHash == board->pawnHash) {
+        pawnTableHits++;
+        return entry->score;
+    }
+
+    entry->pawnHash = board->pawnHash;
+    entry->score = evaluatePawns(board, WHITE) - evaluatePawns(board, BLACK);
+    return entry->score;
+}
+
+// Percentage of pawn hash table probes which were hits.
+double pawnTableHitRate() {
+    if (pawnTableProbes == 0)
+        return 0.0;
+
+    return 100.0 * pawnTableHits / pawnTableProbes;
+}
+
+// Restarts the hit rate count, so it covers one search.
+void resetPawnTableStats() {
+    pawnTableProbes = 0;
+    pawnTableHits = 0;
+}
+
+/* -------------------------------------------------------------------------- */
+/*                                 Attack Info                                */
+/* -------------------------------------------------------------------------- */
+
+// Records the attacks of one piece into the attack info.
+static inline void addAttacks(AttackInfo *info, int color, int piece, U64 attacks) {
+    info->attackedTwice[color] |= info->attacked[color] & attacks;
+    info->attacked[color] |= attacks;
+    info->attackedBy[color][piece] |= attacks;
+
+    // Attack units against the enemy king
+    U64 kingZoneAttacks = attacks & info->kingZone[!color];
+    if (kingZoneAttacks) {
+        info->kingAttackersCount[!color]++;
+        info->kingAttackUnits[!color] += KING_ATTACK_WEIGHTS[piece] * popCount(kingZoneAttacks);
+    }
+}
+
+/**
+ * Computes the squares attacked by every piece on the board in one pass, so
+ * that mobility, king safety and threats can all share the same attacks rather
+ * than each looking them up again.
+ */
+void computeAttackInfo(Board *board, AttackInfo *info) {
+    memset(info, 0, sizeof(AttackInfo));
+    U64 occupied = board->colors[BOTH];
+
+    // Kings and pawns first, so the king zones are known before other pieces
+    for (int color = WHITE; color <= BLACK; color++) {
+        int kingSquare = getlsb(board->pieces[KING] & board->colors[color]);
+        info->kingZone[color] = kingAttacks(kingSquare) | (1ULL << kingSquare);
+
+        U64 pawnAttacks = pawnAttacksSetwise(board->pieces[PAWN] & board->colors[color], color);
+        U64 pushed = pawnPush(board->pieces[PAWN] & board->colors[color], color);
+        info->attackedTwice[color] = eastOne(pushed) & westOne(pushed);
+        info->attacked[color] = pawnAttacks;
+        info->attackedBy[color][PAWN] = pawnAttacks;
+    }
+
+    for (int color = WHITE; color <= BLACK; color++) {
+        U64 kingAttacksBB = kingAttacks(getlsb(board->pieces[KING] & board->colors[color]));
+        info->attackedTwice[color] |= info->attacked[color] & kingAttacksBB;
+        info->attacked[color] |= kingAttacksBB;
+        info->attackedBy[color][KING] = kingAttacksBB;
+
+        // Knights, bishops, rooks and queens
+        for (int piece = KNIGHT; piece <= QUEEN; piece++) {
+            U64 pieces = board->pieces[piece] & board->colors[color];
+            while (pieces) {
+                int square = poplsb(&pieces);
+
+                U64 attacks = (piece == KNIGHT) ? knightAttacks(square)
+                            : (piece == BISHOP) ? bishopAttacks(square, occupied)
+                            : (piece == ROOK)   ? rookAttacks(square, occupied)
+                            :                     queenAttacks(square, occupied);
+
+                addAttacks(info, color, piece, attacks);
+                info->mobility[color][piece] += popCount(attacks) * MOBILITY_VALUES[piece];
+            }
+        }
+    }
+}
+
+/**
+ * Pieces of this color which are in danger: attacked by a less valuable enemy
+ * piece, or attacked and not defended at all. Search uses this to avoid
+ * pruning quiet moves which save a threatened piece.
+ */
+U64 threatenedPieces(Board *board, AttackInfo *info, int color) {
+    U64 ours = board->colors[color];
+    int them = !color;
+
+    U64 minorAttacks = info->attackedBy[them][PAWN];
+    U64 rookAttacks = minorAttacks | info->attackedBy[them][KNIGHT] | info->attackedBy[them][BISHOP];
+    U64 queenAttacks = rookAttacks | info->attackedBy[them][ROOK];
+
+    U64 threatened = (ours & (board->pieces[KNIGHT] | board->pieces[BISHOP]) & minorAttacks)
+                   | (ours & board->pieces[ROOK] & rookAttacks)
+                   | (ours & board->pieces[QUEEN] & queenAttacks);
+
+    // Hanging pieces
+    U64 hanging = ours & ~board->pieces[KING] & info->attacked[them] & ~info->attacked[color];
+
+    return threatened | hanging;
+}
+
+/* -------------------------------------------------------------------------- */
+/*                                Piece Terms                                 */
+/* -------------------------------------------------------------------------- */
+
+// Evaluates how well placed the knights are for this color.
+int evaluateKnights(Board *board, AttackInfo *info, int color) {
+    (void) board;
+    return info->mobility[color][KNIGHT];
+}
+
 // Evaluates how well placed the bishops are for this color.
-int evaluateBishops(Board *board, int color) {
-    int score = 0;
+int evaluateBishops(Board *board, AttackInfo *info, int color) {
+    int score = info->mobility[color][BISHOP];
     U64 bishops = board->pieces[BISHOP] & board->colors[color];
 
     /**
@@ -104,76 +327,54 @@ int evaluateBishops(Board *board, int color) {
      */
     if (popCount(bishops) == 2)
         score += BISHOP_PAIR_VALUE;
-    
-    // Loop through all the bishops of this side
-    while (bishops) {
-        int square = poplsb(&bishops);
-        
-        // Material + PSQT
-        score += MATERIAL_PSQT[color][BISHOP][square];
-
-        // Mobility
-        int count = popCount(Bmagic(square, board->colors[BOTH]));
-        score += count * MOBILITY_VALUES[BISHOP];
-    }
 
     return score;
 }
 
 // Evaluates how well placed the rooks are for this color.
-int evaluateRooks(Board *board, int color) {
-    int score = 0;
-    U64 rooks = board->pieces[ROOK] & board->colors[color];
-
-    // Loop through all the rooks of this side
-    while (rooks) {
-        int square = poplsb(&rooks);
-        
-        // Material + PSQT
-        score += MATERIAL_PSQT[color][ROOK][square];
-
-        // Mobility
-        int count = popCount(Rmagic(square, board->colors[BOTH]));
-        score += count * MOBILITY_VALUES[ROOK];
-    }
-
-    return score;
+int evaluateRooks(Board *board, AttackInfo *info, int color) {
+    (void) board;
+    return info->mobility[color][ROOK];
 }
 
 // Evaluates how well placed the queens are for this color.
-int evaluateQueens(Board *board, int color) {
-    int score = 0;
-    U64 queens = board->pieces[QUEEN] & board->colors[color];
-    
-    // Loop through all the queens of this side
-    while (queens) {
-        int square = poplsb(&queens);
-        
-        // Material + PSQT
-        score += MATERIAL_PSQT[color][QUEEN][square];
+int evaluateQueens(Board *board, AttackInfo *info, int color) {
+    (void) board;
+    return info->mobility[color][QUEEN];
+}
 
-        // Mobility
-        int count = popCount(Qmagic(square, board->colors[BOTH]));
-        score += count * MOBILITY_VALUES[QUEEN];
-    }
+/**
+ * Evaluates the safety of the king of this color. Every enemy piece attacking
+ * the squares around our king adds attack units based on its type, and the
+ * penalty grows quadratically with the units, since a lone attacker is rarely
+ * dangerous while several coordinated ones usually are.
+ * https://www.chessprogramming.org/King_Safety#Attack_Units
+ */
+int evaluateKing(Board *board, AttackInfo *info, int color) {
+    // There *should* only ever be one king
+    assert(popCount(board->pieces[KING] & board->colors[color]) == 1);
+    (void) board;
 
-    return score;
+    if (info->kingAttackersCount[color] < 2)
+        return 0;
+
+    int units = info->kingAttackUnits[color];
+    int penalty = MIN(units * units / KING_SAFETY_DIVISOR, KING_SAFETY_MAX);
+    return S(-penalty, -penalty / 4);
 }
 
-// Evaluates how well placed the king is for this color.
-int evaluateKing(Board *board, int color) {
+// Evaluates the threats against the pieces of this color.
+int evaluateThreats(Board *board, AttackInfo *info, int color) {
     int score = 0;
+    U64 pieces = board->colors[color] & ~board->pieces[PAWN] & ~board->pieces[KING];
 
-    // There *should* only ever be one king
-    assert(popCount(board->pieces[KING] & board->colors[color]) == 1);
-    int kingSquare = getlsb(board->pieces[KING] & board->colors[color]);
+    // Pieces attacked by enemy pawns
+    U64 attackedByPawns = pieces & info->attackedBy[!color][PAWN];
+    score += popCount(attackedByPawns) * THREAT_BY_PAWN_VALUE;
 
-    // PSQT
-    score += MATERIAL_PSQT[color][KING][kingSquare];
-
-    // Virtual mobility as a queen, acts as a crude king safety eval
-    int count = popCount(Qmagic(kingSquare, board->colors[color]));
-    score += count * MOBILITY_VALUES[KING];
+    // Pieces which are attacked but not defended
+    U64 hanging = pieces & info->attacked[!color] & ~info->attacked[color] & ~attackedByPawns;
+    score += popCount(hanging) * HANGING_PIECE_VALUE;
 
     return score;
 }
@@ -205,36 +406,71 @@ void printScore(int score) {
     printf("MG: %d, EG: %d\n", scoreMG, scoreEG);
 }
 
-// Evaluation of the current board state, from the side to move's POV
-int evaluate(Board *board) {
+// The cheap part of the evaluation, which doesn't need any attacks (packed, untapered)
+static int evaluateMaterialAndPawns(Board *board) {
+    int us = board->side;
+
+    // Material and PSQT, kept up to date by the board as pieces move
+    assert(board->psqt == computeMaterialPsqt(board));
+    int score = (us == WHITE) ? board->psqt : -board->psqt;
+
+    // Pawn structure
+    int pawnScore = evaluatePawnStructure(board);
+    score += (us == WHITE) ? pawnScore : -pawnScore;
+
+    // Add tempo bonus for side to move
+    score += TEMPO;
+
+    return score;
+}
+
+// Hand crafted evaluation (packed, untapered and unscaled), from the side to move's POV
+int evaluatePacked(Board *board) {
     // Calculate everything from the our POV (the side to move).
     // Negamax relies on this fact.
     int us = board->side;
     int them = !board->side;
 
     // Start evaluating!
-    int score = 0;
+    // Material, PSQT, pawn structure and tempo
+    int score = evaluateMaterialAndPawns(board);
 
-    // Pawns
-    score += evaluatePawns(board, us) - evaluatePawns(board, them);
+    // Attacks of every piece, shared by the terms below
+    AttackInfo info;
+    computeAttackInfo(board, &info);
 
     // Knights
-    score += evaluateKnights(board, us) - evaluateKnights(board, them);
+    score += evaluateKnights(board, &info, us) - evaluateKnights(board, &info, them);
 
     // Bishops
-    score += evaluateBishops(board, us) - evaluateBishops(board, them);
+    score += evaluateBishops(board, &info, us) - evaluateBishops(board, &info, them);
 
     // Rooks
-    score += evaluateRooks(board, us) - evaluateRooks(board, them);
+    score += evaluateRooks(board, &info, us) - evaluateRooks(board, &info, them);
 
     // Queens
-    score += evaluateQueens(board, us) - evaluateQueens(board, them);
+    score += evaluateQueens(board, &info, us) - evaluateQueens(board, &info, them);
 
     // Kings
-    score += evaluateKing(board, us) - evaluateKing(board, them);
+    score += evaluateKing(board, &info, us) - evaluateKing(board, &info, them);
 
-    // Add tempo bonus for side to move
-    score += (board->side == WHITE) ? TEMPO : -TEMPO;
+    // Threats
+    score += evaluateThreats(board, &info, us) - evaluateThreats(board, &info, them);
+
+    return score;
+}
+
+// Hand crafted evaluation of the current board state, from the side to move's POV
+int evaluateClassical(Board *board) {
+    int score = evaluatePacked(board);
+
+    // Scale down the endgame score when the side ahead will struggle to win
+    MaterialEntry *material = probeMaterial(board);
+    if (material->special) {
+        int strongSide = ScoreEG(score) > 0 ? board->side : !board->side;
+        int factor = scaleFactor(board, material, strongSide);
+        score = S(ScoreMG(score), ScoreEG(score) * factor / SCALE_NORMAL);
+    }
 
     // Taper the score between midgame and endgame
     int phase = getGamePhase(board);
@@ -242,6 +478,75 @@ int evaluate(Board *board) {
     return score;
 }
 
+/* -------------------------------------------------------------------------- */
+/*                                 Eval Cache                                 */
+/* -------------------------------------------------------------------------- */
+
+/**
+ * The same positions get evaluated over and over again through transpositions,
+ * so evaluations are cached in a small direct mapped table keyed by the board
+ * hash. Each thread has its own, so no locking is needed.
+ */
+#define EVAL_CACHE_SIZE (1 << 15)
+
+typedef struct {
+    U64 hash;
+    int eval;
+} EvalCacheEntry;
+
+static _Thread_local EvalCacheEntry evalCache[EVAL_CACHE_SIZE];
+
+// Clears the eval cache, needed whenever the evaluation function changes.
+void clearEvalCache() {
+    memset(evalCache, 0, sizeof(evalCache));
+}
+
+// Evaluation of the current board state, from the side to move's POV
+int evaluate(Board *board) {
+    EvalCacheEntry *entry = &evalCache[board->hash % EVAL_CACHE_SIZE];
+    if (entry->hash == board->hash)
+        return entry->eval;
+
+    // Known endgames have their own evaluation, whichever eval is in use
+    int eval;
+    MaterialEntry *material = probeMaterial(board);
+    if (material->evaluate) {
+        eval = material->evaluate(board, material->strongSide);
+        if (board->side != material->strongSide)
+            eval = -eval;
+    } else {
+        eval = useNNUE ? evaluateNNUE(board) : evaluateClassical(board);
+    }
+
+    entry->hash = board->hash;
+    entry->eval = eval;
+    return eval;
+}
+
+/**
+ * Lazy evaluation for the stand pat in quiescence, where we only need to know
+ * whether the eval beats beta. If material, PSQT and pawn structure alone are
+ * above beta by more than the rest of the evaluation could plausibly take away,
+ * we return right away without computing any attacks. Lazy scores are only
+ * good for that cutoff, so they are not cached. The network, and endgames
+ * which the material table knows about, are always evaluated in full.
+ * https://www.chessprogramming.org/Lazy_Evaluation
+ */
+int evaluateLazy(Board *board, int beta) {
+    if (useNNUE || probeMaterial(board)->special)
+        return evaluate(board);
+
+    EvalCacheEntry *entry = &evalCache[board->hash % EVAL_CACHE_SIZE];
+    if (entry->hash == board->hash)
+        return entry->eval;
+
+    int lazyEval = taper(evaluateMaterialAndPawns(board), getGamePhase(board));
+    if (lazyEval - LAZY_EVAL_MARGIN >= beta)
+        return lazyEval;
+
+    return evaluate(board);
+}
+
 /* -------------------------------------------------------------------------- */
 /*                             Eval debug helpers                             */
 /* -------------------------------------------------------------------------- */
@@ -266,9 +571,13 @@ void printEvaluation(Board *board) {
     printBoard(board);
     int phase = getGamePhase(board);
 
-    // Array of all evaluation functions
-    int (*evalFunction[NB_PIECES])(Board *, int) = {
-        evaluatePawns,
+    AttackInfo info;
+    computeAttackInfo(board, &info);
+
+    // Array of all evaluation functions, pawns are handled separately since
+    // they don't use the attack info. Threats are counted with the kings.
+    int (*evalFunction[NB_PIECES])(Board *, AttackInfo *, int) = {
+        NULL,
         evaluateKnights,
         evaluateBishops,
         evaluateRooks,
@@ -282,8 +591,19 @@ void printEvaluation(Board *board) {
     int whiteTotal = 0, blackTotal = 0;
     for (int piece = PAWN; piece <= KING; piece++) {
         // Get white and black evaluations for this piece
-        int whiteEval = evalFunction[piece](board, WHITE);
-        int blackEval = evalFunction[piece](board, BLACK);
+        int whiteEval = evaluateMaterialPsqt(board, piece, WHITE);
+        int blackEval = evaluateMaterialPsqt(board, piece, BLACK);
+        if (piece == PAWN) {
+            whiteEval += evaluatePawns(board, WHITE);
+            blackEval += evaluatePawns(board, BLACK);
+        } else {
+            whiteEval += evalFunction[piece](board, &info, WHITE);
+            blackEval += evalFunction[piece](board, &info, BLACK);
+        }
+        if (piece == KING) {
+            whiteEval += evaluateThreats(board, &info, WHITE);
+            blackEval += evaluateThreats(board, &info, BLACK);
+        }
 
         // Store white evaluations (midgame, endgame, tapered)
         evals[piece][WHITE].midgame = ScoreMG(whiteEval);
@@ -301,7 +621,7 @@ void printEvaluation(Board *board) {
     }
 
     // Print a beautiful table
-    const char* pieceNames[] = {"Pawns", "Knights", "Bishops", "Rooks", "Queens", "King"};
+    const char* pieceNames[] = {"Pawns", "Knights", "Bishops", "Rooks", "Queens", "King+Threats"};
     puts("|---------------------------------------------------------------------------------------------------------------|");
     puts("|                                         Evaluation Breakdown                                                  |");
     puts("|---------------------------------------------------------------------------------------------------------------|");
@@ -375,7 +695,27 @@ void printEvaluation(Board *board) {
     if (board->side == BLACK) {
         finalEval = -finalEval;
     }
-    assert(finalEval == evaluate(board));
+    // Endgame knowledge from the material table, which the breakdown leaves out
+    MaterialEntry *material = probeMaterial(board);
+    if (material->evaluate) {
+        int knownEval = material->evaluate(board, material->strongSide);
+        printf("Known endgame evaluation: %+.2f\n", evalToPawns(material->strongSide == WHITE ? knownEval : -knownEval));
+    } else if (material->special) {
+        printf("Endgame scale factor: %d/%d if White is ahead, %d/%d if Black is ahead\n",
+            scaleFactor(board, material, WHITE), SCALE_NORMAL, scaleFactor(board, material, BLACK), SCALE_NORMAL);
+    }
+    assert(useNNUE || material->special || finalEval == evaluate(board));
+
+    // Network evaluation, if there is one
+    if (networkIsLoaded()) {
+        int nnueEval = evaluateNNUE(board);
+        if (board->side == BLACK) {
+            nnueEval = -nnueEval;
+        }
+        printf("NNUE evaluation: %+.2f (%s)\n", evalToPawns(nnueEval), useNNUE ? "in use" : "not in use");
+    }
+
+    printf("Pawn hash hit rate: %.2f%%\n", pawnTableHitRate());
 }
 
 
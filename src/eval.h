@@ -69,9 +69,36 @@ static const int MOBILITY_VALUES[NB_PIECES] = {
     S(  5,  5), // Bishop
     S(  4,  4), // Rook
     S(  0,  4), // Queen
-    S( -5,  0)  // King
+    S(  0,  0)  // King
 };
 
+/**
+ * King safety attack units, added for each square next to the enemy king that
+ * a piece of this type attacks. The penalty is units^2 / KING_SAFETY_DIVISOR
+ * in the midgame, capped to KING_SAFETY_MAX, and only applies once at least
+ * two pieces take part in the attack.
+ */
+static const int KING_ATTACK_WEIGHTS[NB_PIECES] = {
+    0, // Pawn
+    2, // Knight
+    2, // Bishop
+    3, // Rook
+    5, // Queen
+    0, // King
+};
+#define KING_SAFETY_DIVISOR 4
+#define KING_SAFETY_MAX 500
+
+/**
+ * How far above beta material, PSQT and pawn structure must be for
+ * evaluateLazy() to skip the rest of the evaluation.
+ */
+#define LAZY_EVAL_MARGIN 500
+
+// Threats against our non-pawn pieces
+static const int THREAT_BY_PAWN_VALUE = S(-40, -30);
+static const int HANGING_PIECE_VALUE = S(-25, -20);
+
 /**
  * Bishop pair value
  * Conventional chess wisdom dictates that having a 'pair' of bishops is desirable,
@@ -80,6 +107,23 @@ static const int MOBILITY_VALUES[NB_PIECES] = {
  */
 static const int BISHOP_PAIR_VALUE = S(30, 50);
 
+/**
+ * Pawn structure values
+ * A passed pawn has no enemy pawns in front of it on its own or neighbouring
+ * files, and gets a bonus based on how far it has advanced (on top of the
+ * PSQT). Isolated pawns have no friendly pawns on neighbouring files, doubled
+ * pawns have a friendly pawn in front of them, and backward pawns can't safely
+ * advance and can't ever be defended by a friendly pawn.
+ * https://www.chessprogramming.org/Pawn_Structure
+ */
+static const int PASSED_PAWN_VALUES[8] = {
+    S(  0,   0), S(  0,   5), S(  0,  10), S(  5,  20),
+    S( 15,  35), S( 30,  60), S( 50,  90), S(  0,   0),
+};
+static const int ISOLATED_PAWN_VALUE = S(-10, -12);
+static const int DOUBLED_PAWN_VALUE = S(-10, -20);
+static const int BACKWARD_PAWN_VALUE = S(-8, -8);
+
 /**
  * Piece square tables (PSQT) are tables which score how good a piece generally
  * is, when placed on each square.
@@ -169,7 +213,36 @@ static const int PSQT_BASE[NB_PIECES][64] = {
     },
 };
 
+/**
+ * Attacks of every piece on the board, computed once per evaluation and shared
+ * by mobility, king safety and threats.
+ */
+typedef struct {
+    U64 attackedBy[2][NB_PIECES]; // Squares attacked by each piece type of each color
+    U64 attacked[2];              // Squares attacked by each color
+    U64 attackedTwice[2];         // Squares attacked at least twice by each color
+    U64 kingZone[2];              // The king and the squares around it for each color
+    int kingAttackersCount[2];    // Enemy pieces attacking each color's king zone
+    int kingAttackUnits[2];       // Attack units against each color's king
+    int mobility[2][NB_PIECES];   // Packed mobility score of each piece type
+} AttackInfo;
+
+// Combination of material and piece square tables, see initEvaluation()
+extern int MATERIAL_PSQT[2][NB_PIECES][64];
+
 // Evaluation public facing functions
 int evaluate(Board *board);
+int evaluateLazy(Board *board, int beta);
+int evaluateClassical(Board *board);
+int evaluatePacked(Board *board);
+int getGamePhase(Board *board);
+void clearEvalCache();
+void computeAttackInfo(Board *board, AttackInfo *info);
+U64 threatenedPieces(Board *board, AttackInfo *info, int color);
+int computeMaterialPsqt(Board *board);
+int computeGamePhase(Board *board);
+double pawnTableHitRate();
+void resetPawnTableStats();
 void printEvaluation(Board *board);
+
 void initEvaluation();
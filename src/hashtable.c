@@ -11,7 +11,8 @@
 
 
 // Global variable :skull:
-HashTable hashTable;
+// Each thread has its own, so self-play threads don't need to share one.
+_Thread_local HashTable hashTable;
 
 /* -------------------------------------------------------------------------- */
 /*                         Hash table helper functions                        */
@@ -45,6 +46,7 @@ void clearHashTable() {
         hashTable.entries[i].bestMove = NO_MOVE;
         hashTable.entries[i].depth = 0;
         hashTable.entries[i].score = 0;
+        hashTable.entries[i].staticEval = HASH_EVAL_NONE;
         hashTable.entries[i].flag = 0;
     }
 }
@@ -94,7 +96,9 @@ void initHashTable(int sizeMB) {
 /* -------------------------------------------------------------------------- */
 
 // Stores given information into the hash table.
-void hashTableStore(U64 hash, int ply, Move bestMove, int depth, int score, int flag) {
+void hashTableStore(U64 hash, int ply, Move bestMove, int depth, int score, int staticEval, int flag) {
+    assert(hashTable.count > 0); // initHashTable wasn't called on this thread
+
     // Calculate hash index and retrieve corresponding entry
     int index = hash % hashTable.count;
     HashEntry *entry = &hashTable.entries[index];
@@ -108,11 +112,14 @@ void hashTableStore(U64 hash, int ply, Move bestMove, int depth, int score, int
     entry->hashKey = hash;
     entry->depth = depth;
     entry->score = toHashScore(score, ply);
+    entry->staticEval = (staticEval == EVAL_NONE) ? HASH_EVAL_NONE : staticEval;
     entry->flag = flag;
 }
 
 // Probes hash table for information about the current position
-int hashTableProbe(U64 hash, int ply, Move *hashMove, int *depth, int *score, int *flag) {
+int hashTableProbe(U64 hash, int ply, Move *hashMove, int *depth, int *score, int *staticEval, int *flag) {
+    assert(hashTable.count > 0); // initHashTable wasn't called on this thread
+
     // Calculate hash index and retrieve corresponding entry
     int index = hash % hashTable.count;
     HashEntry *entry = &hashTable.entries[index];
@@ -123,6 +130,7 @@ int hashTableProbe(U64 hash, int ply, Move *hashMove, int *depth, int *score, in
         *hashMove = entry->bestMove;
         *depth = entry->depth;
         *score = fromHashScore(entry->score, ply);
+        *staticEval = (entry->staticEval == HASH_EVAL_NONE) ? EVAL_NONE : entry->staticEval;
         *flag = entry->flag;
 
         return PROBE_SUCCESS;
@@ -135,6 +143,8 @@ int hashTableProbe(U64 hash, int ply, Move *hashMove, int *depth, int *score, in
  * Probes hash table for just the hash move
  */
 Move probeHashMove(U64 hash) {
+    assert(hashTable.count > 0); // initHashTable wasn't called on this thread
+
     // Calculate hash index and retrieve corresponding entry
     int index = hash % hashTable.count;
     HashEntry *entry = &hashTable.entries[index];
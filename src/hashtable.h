@@ -23,13 +23,17 @@ enum {
 // Probing flags
 enum { PROBE_FAIL, PROBE_SUCCESS };
 
-// Hash entry
+// Stored static eval of entries which don't have one (e.g. in check)
+#define HASH_EVAL_NONE INT16_MIN
+
+// Hash entry (16 bytes)
 typedef struct {
   U64 hashKey;
   Move bestMove;
-  int16_t depth;
   int16_t score;
-  int16_t flag;
+  int16_t staticEval;
+  int8_t depth;
+  uint8_t flag;
 } HashEntry;
 
 typedef struct {
@@ -44,7 +48,7 @@ void clearHashTable();
 double occupiedHashEntries();
 
 // For use in game
-void hashTableStore(U64 hash, int ply, Move bestMove, int depth, int score, int flag);
-int hashTableProbe(U64 hash, int ply, Move *hashMove, int *depth, int *score, int *flag);
+void hashTableStore(U64 hash, int ply, Move bestMove, int depth, int score, int staticEval, int flag);
+int hashTableProbe(U64 hash, int ply, Move *hashMove, int *depth, int *score, int *staticEval, int *flag);
 Move probeHashMove(U64 hash);
 
@@ -348,7 +348,44 @@ U64 initmagicmoves_Bmoves(const int square, const U64 occ) {
 */
 #endif
 
+#ifdef USE_PEXT
+// MODIFICATION BY ME: PEXT indexed tables, see magicmoves.h
+U64 pextmovesbdb[5248];
+U64 pextmovesrdb[102400];
+unsigned int pextmoves_b_offset[64];
+unsigned int pextmoves_r_offset[64];
+
+// Fills the tables with the moves for every subset of each square's mask, in
+// the order pext extracts them.
+static void initpextmoves(void) {
+    unsigned int bishopOffset = 0, rookOffset = 0;
+
+    for (int square = 0; square < 64; square++) {
+        U64 subsets = C64(1) << __builtin_popcountll(magicmoves_b_mask[square]);
+        pextmoves_b_offset[square] = bishopOffset;
+        for (U64 i = 0; i < subsets; i++) {
+            U64 occupancy = _pdep_u64(i, magicmoves_b_mask[square]);
+            pextmovesbdb[bishopOffset + i] = initmagicmoves_Bmoves(square, occupancy);
+        }
+        bishopOffset += subsets;
+
+        subsets = C64(1) << __builtin_popcountll(magicmoves_r_mask[square]);
+        pextmoves_r_offset[square] = rookOffset;
+        for (U64 i = 0; i < subsets; i++) {
+            U64 occupancy = _pdep_u64(i, magicmoves_r_mask[square]);
+            pextmovesrdb[rookOffset + i] = initmagicmoves_Rmoves(square, occupancy);
+        }
+        rookOffset += subsets;
+    }
+}
+#endif
+
 void initmagicmoves(void) {
+#ifdef USE_PEXT
+    initpextmoves();
+    return;
+#endif
+
     int i;
 
     // for bitscans :
@@ -92,6 +92,12 @@
 #include <stdint.h>
 typedef uint64_t U64;
 
+// MODIFICATION BY ME:
+// Define USE_PEXT (make PEXT=1) to index the tables with the BMI2 pext
+// instruction instead of magic multiplication. The masks are shared, but the
+// tables are generated at startup in initmagicmoves() and need no magics.
+// #define USE_PEXT
+
 // #ifndef __64_BIT_INTEGER_DEFINED__
 // #define __64_BIT_INTEGER_DEFINED__
 // #if defined(_MSC_VER) && _MSC_VER < 1300
@@ -222,7 +228,34 @@ extern PERFECT_MAGIC_HASH magicmoves_r_indices[64][1 << 12];
 #endif
 #endif // PERFCT_MAGIC_HASH
 
-#ifdef USE_INLINING
+#if defined(USE_PEXT)
+#include <immintrin.h>
+
+extern U64 pextmovesbdb[5248];
+extern U64 pextmovesrdb[102400];
+extern unsigned int pextmoves_b_offset[64];
+extern unsigned int pextmoves_r_offset[64];
+
+static MMINLINE U64 Bmagic(const unsigned int square, const U64 occupancy) {
+    return pextmovesbdb[pextmoves_b_offset[square] + _pext_u64(occupancy, magicmoves_b_mask[square])];
+}
+static MMINLINE U64 Rmagic(const unsigned int square, const U64 occupancy) {
+    return pextmovesrdb[pextmoves_r_offset[square] + _pext_u64(occupancy, magicmoves_r_mask[square])];
+}
+static MMINLINE U64 BmagicNOMASK(const unsigned int square, const U64 occupancy) {
+    return Bmagic(square, occupancy);
+}
+static MMINLINE U64 RmagicNOMASK(const unsigned int square, const U64 occupancy) {
+    return Rmagic(square, occupancy);
+}
+static MMINLINE U64 Qmagic(const unsigned int square, const U64 occupancy) {
+    return Bmagic(square, occupancy) | Rmagic(square, occupancy);
+}
+static MMINLINE U64 QmagicNOMASK(const unsigned int square,
+                                 const U64 occupancy) {
+    return Qmagic(square, occupancy);
+}
+#elif defined(USE_INLINING)
 static MMINLINE U64 Bmagic(const unsigned int square, const U64 occupancy) {
 #ifndef PERFECT_MAGIC_HASH
 #ifdef MINIMIZE_MAGIC
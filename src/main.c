@@ -1,5 +1,6 @@
 #include <stdio.h>
 #include <string.h>
+#include <stdlib.h>
 #include <assert.h>
 
 #include "uci.h"
@@ -12,7 +13,14 @@
 #include "search.h"
 #include "perft.h"
 #include "eval.h"
+#include "nnue.h"
 #include "bench.h"
+#include "tune.h"
+#include "datagen.h"
+#include "batch.h"
+#include "pgn.h"
+#include "makebook.h"
+#include "bitbase.h"
 
 #define NAME_VERSION_STRING WHT NAME " [" CYN VERSION WHT "]" CRESET
 void welcome() {
@@ -46,6 +54,8 @@ void initialise() {
 
     // Evaluation
     initEvaluation();
+    initNNUE();
+    initBitbases();
 }
 
 int main(int argc, char *argv[]) {
@@ -58,6 +68,51 @@ int main(int argc, char *argv[]) {
             bench();
             return 0;
         }
+
+        // Tune the evaluation, e.g. ./Young_Master tune data.epd 2000
+        if (strcmp(argv[1], "tune") == 0 && argc >= 3) {
+            tune(argv[2], argc >= 4 ? atoi(argv[3]) : TUNE_DEFAULT_EPOCHS, argc >= 5 ? atoi(argv[4]) : 0);
+            return 0;
+        }
+
+        // Generate self-play data, e.g. ./Young_Master datagen data.bin 1000000 5000
+        if (strcmp(argv[1], "datagen") == 0 && argc >= 3) {
+            datagen(argv[2],
+                    argc >= 4 ? strtoull(argv[3], NULL, 10) : DATAGEN_DEFAULT_POSITIONS,
+                    argc >= 5 ? atoi(argv[4]) : DATAGEN_DEFAULT_NODES,
+                    argc >= 6 ? atoi(argv[5]) : 0);
+            return 0;
+        }
+
+        // Evaluate or search packed positions, e.g. ./Young_Master batch search data.bin 5000
+        if (strcmp(argv[1], "batch") == 0 && argc >= 4) {
+            runBatchFile(argv[3], strcmp(argv[2], "search") == 0,
+                         argc >= 5 ? atoi(argv[4]) : BATCH_DEFAULT_NODES,
+                         argc >= 6 ? atoi(argv[5]) : 0);
+            return 0;
+        }
+
+        // Convert a PGN into positions, e.g. ./Young_Master pgn games.pgn games.chain
+        if (strcmp(argv[1], "pgn") == 0 && argc >= 4) {
+            convertPgn(argv[2], argv[3], argc >= 5 ? atoi(argv[4]) : 0);
+            return 0;
+        }
+
+        // Generate endgame bitbases, e.g. ./Young_Master bitbases bitbases
+        if (strcmp(argv[1], "bitbases") == 0 && argc >= 3) {
+            generateBitbases(argv[2], argc >= 4 ? atoi(argv[3]) : 0);
+            return 0;
+        }
+
+        // Build an opening book from a PGN, e.g. ./Young_Master makebook games.pgn book.bin 20 5
+        if (strcmp(argv[1], "makebook") == 0 && argc >= 4) {
+            makeBook(argv[2], argv[3],
+                     argc >= 5 ? atoi(argv[4]) : MAKEBOOK_DEFAULT_PLIES,
+                     argc >= 6 ? atoi(argv[5]) : MAKEBOOK_DEFAULT_MIN_GAMES,
+                     argc >= 7 ? atoi(argv[6]) : 0,
+                     argc >= 8 ? atoi(argv[7]) : 0);
+            return 0;
+        }
     }
 
     // Run UCI loop otherwise
@@ -0,0 +1,279 @@
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "makebook.h"
+#include "batch.h"
+#include "board.h"
+#include "book.h"
+#include "makemove.h"
+#include "packed.h"
+#include "pgn.h"
+#include "search.h"
+#include "utils.h"
+#include "zobrist.h"
+
+// The statistics are split into 2^MAKEBOOK_SHARD_BITS shards by their hash
+#define MAKEBOOK_SHARD_BITS 6
+#define MAKEBOOK_SHARDS (1 << MAKEBOOK_SHARD_BITS)
+
+// Starting number of slots of each shard, doubled whenever it gets half full
+#define MAKEBOOK_SHARD_SIZE 1024
+
+// Statistics of a move from a position
+typedef struct {
+    U64 key;                  // Book key of the position
+    uint16_t move;            // Book move, see book.h
+    uint32_t games;           // Games the move was played in, 0 for empty slots
+    uint32_t points;          // 2 per win and 1 per draw for the side which played it
+    PackedBoard position;     // Position before the move, to search the move from
+} BookMove;
+
+// Open addressing hash map of moves, with its own lock
+typedef struct {
+    pthread_mutex_t lock;
+    BookMove *moves;
+    size_t capacity;
+    size_t count;
+} BookShard;
+
+typedef struct {
+    BookShard shards[MAKEBOOK_SHARDS];
+    int plies;                // Moves counted from the start of each game
+} BookStats;
+
+/* -------------------------------------------------------------------------- */
+/*                                  Counting                                  */
+/* -------------------------------------------------------------------------- */
+
+// Book keys are already random, so only the move has to be mixed in
+static inline U64 moveHash(U64 key, uint16_t move) {
+    return key ^ (move * 0x9E3779B97F4A7C15ULL);
+}
+
+static BookMove *findSlot(BookMove *moves, size_t capacity, U64 key, uint16_t move) {
+    size_t index = moveHash(key, move) & (capacity - 1);
+    while (moves[index].games && (moves[index].key != key || moves[index].move != move))
+        index = (index + 1) & (capacity - 1);
+    return &moves[index];
+}
+
+static void growShard(BookShard *shard) {
+    size_t capacity = shard->capacity * 2;
+    BookMove *moves = calloc(capacity, sizeof(BookMove));
+
+    for (size_t i = 0; i < shard->capacity; i++) {
+        BookMove *old = &shard->moves[i];
+        if (old->games)
+            *findSlot(moves, capacity, old->key, old->move) = *old;
+    }
+
+    free(shard->moves);
+    shard->moves = moves;
+    shard->capacity = capacity;
+}
+
+static void addMove(BookStats *stats, Board *board, U64 key, uint16_t move, int points) {
+    BookShard *shard = &stats->shards[moveHash(key, move) >> (64 - MAKEBOOK_SHARD_BITS)];
+    pthread_mutex_lock(&shard->lock);
+
+    if (2 * (shard->count + 1) > shard->capacity)
+        growShard(shard);
+
+    BookMove *slot = findSlot(shard->moves, shard->capacity, key, move);
+    if (slot->games == 0) {
+        slot->key = key;
+        slot->move = move;
+        packBoard(board, 0, PACKED_DRAW, &slot->position);
+        shard->count++;
+    }
+
+    slot->games++;
+    slot->points += points;
+    pthread_mutex_unlock(&shard->lock);
+}
+
+// PGN callback, counts the first moves of a game
+static void countGame(void *context, Board *board, const Move *moves, int count, int result) {
+    BookStats *stats = context;
+
+    for (int i = 0; i < MIN(count, stats->plies); i++) {
+        int points = (board->side == WHITE) ? result : PACKED_WIN - result;
+        addMove(stats, board, polyglotKey(board), moveToBook(moves[i]), points);
+        makeMove(board, moves[i]);
+    }
+}
+
+/* -------------------------------------------------------------------------- */
+/*                                  Building                                  */
+/* -------------------------------------------------------------------------- */
+
+// Sorts by key as the book needs, with the best moves of a position first
+static int compareMoves(const void *a, const void *b) {
+    const BookMove *x = a, *y = b;
+    if (x->key != y->key)
+        return x->key < y->key ? -1 : 1;
+    return (x->points < y->points) - (x->points > y->points);
+}
+
+// Moves from the shards which were played in enough games, sorted
+static BookMove *collectMoves(BookStats *stats, int minGames, size_t *count) {
+    size_t total = 0;
+    for (int i = 0; i < MAKEBOOK_SHARDS; i++)
+        total += stats->shards[i].count;
+
+    BookMove *moves = malloc(MAX(total, 1) * sizeof(BookMove));
+    *count = 0;
+    for (int i = 0; i < MAKEBOOK_SHARDS; i++) {
+        BookShard *shard = &stats->shards[i];
+        for (size_t j = 0; j < shard->capacity; j++) {
+            if (shard->moves[j].games && shard->moves[j].games >= (uint32_t) minGames)
+                moves[(*count)++] = shard->moves[j];
+        }
+    }
+
+    qsort(moves, *count, sizeof(BookMove), compareMoves);
+    return moves;
+}
+
+/**
+ * Searches the position after every move, and drops moves (sets their games to 0)
+ * which score more than MAKEBOOK_MARGIN below the best move of their position.
+ * Returns the number of moves dropped.
+ */
+static size_t validateMoves(BookMove *moves, size_t count, int nodes, int threads) {
+    PackedBoard *children = malloc(MAX(count, 1) * sizeof(PackedBoard));
+    int *scores = malloc(MAX(count, 1) * sizeof(int));
+    int *sides = malloc(MAX(count, 1) * sizeof(int));
+    Board *board = malloc(sizeof(Board));
+
+    for (size_t i = 0; i < count; i++) {
+        unpackBoard(&moves[i].position, board);
+        sides[i] = board->side;
+
+        Move move = bookToMove(board, moves[i].move);
+        makeMove(board, move);
+        packBoard(board, 0, PACKED_DRAW, &children[i]);
+        undoMove(board, move);
+    }
+
+    searchBatch(children, count, nodes, scores, NULL, threads);
+
+    size_t dropped = 0;
+    for (size_t first = 0, last; first < count; first = last) {
+        int best = -INF_SCORE;
+        for (last = first; last < count && moves[last].key == moves[first].key; last++) {
+            // Scores are from White's POV, turn them to the side which played the move
+            scores[last] = (sides[last] == WHITE) ? scores[last] : -scores[last];
+            best = MAX(best, scores[last]);
+        }
+
+        for (size_t i = first; i < last; i++) {
+            if (scores[i] < best - MAKEBOOK_MARGIN) {
+                moves[i].games = 0;
+                dropped++;
+            }
+        }
+    }
+
+    free(sides);
+    free(board);
+    free(scores);
+    free(children);
+    return dropped;
+}
+
+/**
+ * Writes the moves which weren't dropped, weighted by their points. Weights
+ * only need to be right relative to the other moves of the position, so
+ * they're scaled down per position if they don't fit in 16 bits.
+ */
+static size_t writeBook(FILE *file, const BookMove *moves, size_t count) {
+    size_t written = 0;
+
+    for (size_t first = 0, last; first < count; first = last) {
+        uint32_t most = 0;
+        for (last = first; last < count && moves[last].key == moves[first].key; last++)
+            most = MAX(most, moves[last].points);
+
+        for (size_t i = first; i < last; i++) {
+            if (moves[i].games == 0)
+                continue;
+
+            BookEntry entry = { .key = moves[i].key, .move = moves[i].move, .learn = 0 };
+            entry.weight = (most > UINT16_MAX) ? (U64) moves[i].points * UINT16_MAX / most : moves[i].points;
+
+            uint8_t out[BOOK_ENTRY_SIZE];
+            encodeBookEntry(&entry, out);
+            written += fwrite(out, BOOK_ENTRY_SIZE, 1, file);
+        }
+    }
+
+    return written;
+}
+
+// Builds a book from the games of a PGN, see makebook.h.
+void makeBook(const char *input, const char *output, int plies, int minGames, int nodes, int threads) {
+    size_t size;
+    const char *data = mapFile(input, &size);
+    if (data == NULL) {
+        printf("Could not open %s\n", input);
+        return;
+    }
+
+    FILE *file = fopen(output, "wb");
+    if (file == NULL) {
+        printf("Could not open %s\n", output);
+        unmapFile(data, size);
+        return;
+    }
+
+    if (threads <= 0)
+        threads = cpuCount();
+
+    BookStats *stats = malloc(sizeof(BookStats));
+    stats->plies = plies;
+    for (int i = 0; i < MAKEBOOK_SHARDS; i++) {
+        BookShard *shard = &stats->shards[i];
+        pthread_mutex_init(&shard->lock, NULL);
+        shard->capacity = MAKEBOOK_SHARD_SIZE;
+        shard->moves = calloc(shard->capacity, sizeof(BookMove));
+        shard->count = 0;
+    }
+
+    // Every thread adds to the same shards
+    void **contexts = malloc(threads * sizeof(void *));
+    for (int i = 0; i < threads; i++)
+        contexts[i] = stats;
+
+    int start = getTime();
+    size_t games, errors;
+    readPgn(data, size, threads, countGame, contexts, &games, &errors);
+
+    size_t count;
+    BookMove *moves = collectMoves(stats, minGames, &count);
+    printf("Counted moves of %zu games in %d ms, %zu moves played in at least %d games\n",
+           games, getTime() - start, count, minGames);
+    if (errors)
+        printf("Skipped %zu games with moves which couldn't be parsed\n", errors);
+
+    if (nodes > 0) {
+        start = getTime();
+        size_t dropped = validateMoves(moves, count, nodes, threads);
+        printf("Searched %zu moves at %d nodes in %d ms, dropped %zu\n",
+               count, nodes, getTime() - start, dropped);
+    }
+
+    size_t written = writeBook(file, moves, count);
+    printf("Wrote %zu entries to %s\n", written, output);
+
+    for (int i = 0; i < MAKEBOOK_SHARDS; i++) {
+        free(stats->shards[i].moves);
+        pthread_mutex_destroy(&stats->shards[i].lock);
+    }
+    free(moves);
+    free(contexts);
+    free(stats);
+    fclose(file);
+    unmapFile(data, size);
+}
@@ -0,0 +1,24 @@
+// Opening book building from PGN games.
+//
+// Every move played in the first plies of each game is counted per position,
+// with the points it scored for the side which played it (2 for a win, 1 for
+// a draw). The counts go into a hash map split into shards with a lock each,
+// so every thread reading the PGN (see pgn.h) can add to it at once. Moves
+// played in fewer than the minimum number of games are left out, and the
+// rest are written as a Polyglot book (see book.h), weighted by their points.
+//
+// With a node count, the moves of each position are also checked with a short
+// search of the position after each move, and moves which score much worse
+// than the best one are left out, e.g. blunders which happened to win.
+//
+// Usage: makebook <input.pgn> <output.bin> [plies] [min games] [nodes] [threads]
+
+#pragma once
+
+#define MAKEBOOK_DEFAULT_PLIES 20
+#define MAKEBOOK_DEFAULT_MIN_GAMES 1
+
+// How much worse than the best move a move can search to stay in the book
+#define MAKEBOOK_MARGIN 100
+
+void makeBook(const char *input, const char *output, int plies, int minGames, int nodes, int threads);
@@ -5,6 +5,8 @@
 #include "board.h"
 #include "move.h"
 #include "zobrist.h"
+#include "material.h"
+#include "nnue.h"
 
 /* -------------------------------------------------------------------------- */
 /*                              Castling Helpers                              */
@@ -51,8 +53,9 @@ static inline void RemoveBlackQueenCastling(Board *board) {
 /* -------------------------------------------------------------------------- */
 /**
  * These functions are carbon copies of the functions in board.c, but without
- * hash updates since they are unnecessary in undoMove. They make undoMove much
- * more performant, although at the cost of code duplication.
+ * hash, PSQT and phase updates since they are unnecessary in undoMove, where
+ * those are restored from the undo. They make undoMove much more performant,
+ * although at the cost of code duplication.
  * 
  * TODO: do something about these ugly functions :/
  */
@@ -133,6 +136,7 @@ void makeNullMove(Board *board) {
     undo->fiftyMove = board->fiftyMove;
     undo->hash = board->hash;
     undo->move = NO_MOVE;
+    pushAccumulator(board);
 
     // Update side to move and ply
     board->side = !board->side;
@@ -189,6 +193,10 @@ void undoMove(Board *board, Move move) {
     board->epSquare = undo->epSquare;
     board->fiftyMove = undo->fiftyMove;
     board->hash = undo->hash;
+    board->pawnHash = undo->pawnHash;
+    board->materialKey = undo->materialKey;
+    board->psqt = undo->psqt;
+    board->phase = undo->phase;
 
     int capturedPiece = undo->capturedPiece;
     int movedPiece = undo->movedPiece;
@@ -264,8 +272,13 @@ int makeMove(Board *board, Move move) {
     undo->fiftyMove = board->fiftyMove;
     undo->movedPiece = movedPiece;
     undo->hash = board->hash;
+    undo->pawnHash = board->pawnHash;
+    undo->materialKey = board->materialKey;
     undo->capturedPiece = NO_PIECE;
     undo->move = move;
+    undo->psqt = board->psqt;
+    undo->phase = board->phase;
+    pushAccumulator(board);
 
     // Clear en passant square information
     if (board->epSquare != NO_SQ) {
@@ -384,6 +397,8 @@ int makeMove(Board *board, Move move) {
     board->hash ^= SideKey;
 
     assert(board->hash == generateHash(board));
+    assert(board->pawnHash == generatePawnHash(board));
+    assert(board->materialKey == computeMaterialKey(board));
 
     // If we're in check, that move was illegal
     if (moveWasIllegal(board))
@@ -0,0 +1,356 @@
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "mate.h"
+#include "board.h"
+#include "makemove.h"
+#include "movegen.h"
+#include "search.h"
+#include "utils.h"
+
+// Proof or disproof number of a solved node, sums of numbers are capped to it
+#define MATE_INF (1u << 30)
+
+// Proof table entry (16 bytes)
+typedef struct {
+    uint32_t lock;            // Upper half of the hash
+    uint32_t phi;             // Numbers for the side to move
+    uint32_t delta;
+    uint8_t depth;            // Plies left when the numbers were found
+} MateEntry;
+
+static MateEntry *mateTable = NULL;
+static uint64_t mateTableMask;
+
+/* -------------------------------------------------------------------------- */
+/*                                 Proof table                                */
+/* -------------------------------------------------------------------------- */
+
+// The attacker moves when an odd number of plies is left, so the last ply is always theirs
+static inline bool attackerToMove(int depth) {
+    return depth & 1;
+}
+
+static void clearMateTable() {
+    if (mateTable == NULL) {
+        uint64_t count = ((uint64_t) MATE_HASH_SIZE_MB << 20) / sizeof(MateEntry);
+        mateTable = malloc(count * sizeof(MateEntry));
+        mateTableMask = count - 1;
+    }
+
+    memset(mateTable, 0, (mateTableMask + 1) * sizeof(MateEntry));
+}
+
+static bool mateTableProbe(U64 hash, int depth, uint32_t *phi, uint32_t *delta) {
+    MateEntry *entry = &mateTable[hash & mateTableMask];
+    if (entry->lock != (uint32_t) (hash >> 32))
+        return false;
+
+    // A mate found with fewer plies left still works with more, and no mate
+    // with more plies left means none with fewer either.
+    bool mate = attackerToMove(depth) ? entry->phi == 0 : entry->delta == 0;
+    bool noMate = attackerToMove(depth) ? entry->delta == 0 : entry->phi == 0;
+
+    if (entry->depth == depth || (mate && entry->depth <= depth) || (noMate && entry->depth >= depth)) {
+        *phi = entry->phi;
+        *delta = entry->delta;
+        return true;
+    }
+
+    return false;
+}
+
+static void mateTableStore(U64 hash, int depth, uint32_t phi, uint32_t delta) {
+    MateEntry *entry = &mateTable[hash & mateTableMask];
+    entry->lock = (uint32_t) (hash >> 32);
+    entry->phi = phi;
+    entry->delta = delta;
+    entry->depth = depth;
+}
+
+/* -------------------------------------------------------------------------- */
+/*                                    Nodes                                   */
+/* -------------------------------------------------------------------------- */
+
+static inline uint32_t addNumbers(uint32_t a, uint32_t b) {
+    return MIN(a + b, MATE_INF);
+}
+
+// Legal moves searched from a node. The attacker's last move has to give mate, so only checks are tried.
+static int nodeMoves(Board *board, int depth, Move *out) {
+    MoveList moves;
+    generatePseudoLegalMoves(&moves, board);
+
+    int count = 0;
+    for (int i = 0; i < moves.count; i++) {
+        Move move = moves.list[i];
+        if (makeMove(board, move) && (depth != 1 || boardIsInCheck(board)))
+            out[count++] = move;
+        undoMove(board, move);
+    }
+
+    return count;
+}
+
+static int countLegalMoves(Board *board) {
+    MoveList moves;
+    generatePseudoLegalMoves(&moves, board);
+
+    int count = 0;
+    for (int i = 0; i < moves.count; i++) {
+        count += makeMove(board, moves.list[i]);
+        undoMove(board, moves.list[i]);
+    }
+
+    return count;
+}
+
+/**
+ * Starting numbers of a node, from the table if it has them. Mates,
+ * stalemates and the end of the line are solved on the spot. Otherwise it
+ * takes one leaf to prove the side to move wins, and the defender's number
+ * of replies to prove they don't, which makes checks get tried first.
+ */
+static void initNode(Board *board, int depth, uint32_t *phi, uint32_t *delta) {
+    if (mateTableProbe(board->hash, depth, phi, delta))
+        return;
+
+    int legalMoves = countLegalMoves(board);
+
+    if (legalMoves == 0 && (boardIsInCheck(board) || attackerToMove(depth))) {
+        // Mated, or the attacker was stalemated
+        *phi = MATE_INF;
+        *delta = 0;
+    } else if (legalMoves == 0 || depth == 0) {
+        // The defender was stalemated or got through
+        *phi = 0;
+        *delta = MATE_INF;
+    } else {
+        *phi = 1;
+        *delta = attackerToMove(depth) ? 1 : legalMoves;
+    }
+}
+
+/**
+ * Multiple iterative deepening (MID) of df-pn, in negamax form. Searches the
+ * child with the smallest delta, which is the most proving one, until the
+ * node's numbers reach its thresholds. The child's thresholds are set so it
+ * returns as soon as another child becomes more proving, or the node reaches
+ * its own thresholds.
+ * https://www.chessprogramming.org/Proof-Number_Search#Depth-First_Proof-Number_Search
+ */
+static void mid(Engine *engine, int depth, uint32_t thPhi, uint32_t thDelta, uint32_t *phi, uint32_t *delta) {
+    Board *board = &engine->board;
+    engine->searchStats.nodes++;
+
+    // Periodically check if the search should be stopped.
+    if ((engine->searchStats.nodes & 0x3FF) == 0)
+        checkSearchOver(engine);
+
+    Move moves[MAX_LEGAL_MOVES];
+    uint32_t childPhi[MAX_LEGAL_MOVES], childDelta[MAX_LEGAL_MOVES];
+    int count = nodeMoves(board, depth, moves);
+
+    for (int i = 0; i < count; i++) {
+        makeMove(board, moves[i]);
+        initNode(board, depth - 1, &childPhi[i], &childDelta[i]);
+        undoMove(board, moves[i]);
+    }
+
+    while (true) {
+        // phi is the smallest delta of the children, and delta the sum of their phis
+        int best = 0;
+        uint32_t secondDelta = MATE_INF;
+        *phi = MATE_INF;
+        *delta = 0;
+
+        for (int i = 0; i < count; i++) {
+            *delta = addNumbers(*delta, childPhi[i]);
+            if (childDelta[i] < *phi) {
+                secondDelta = *phi;
+                *phi = childDelta[i];
+                best = i;
+            } else if (childDelta[i] < secondDelta) {
+                secondDelta = childDelta[i];
+            }
+        }
+
+        if (*phi >= thPhi || *delta >= thDelta || engine->searchState == SEARCH_STOPPED)
+            break;
+
+        uint32_t childThPhi = thDelta + childPhi[best] - *delta;
+        uint32_t childThDelta = MIN(thPhi, secondDelta + 1);
+
+        makeMove(board, moves[best]);
+        mid(engine, depth - 1, childThPhi, childThDelta, &childPhi[best], &childDelta[best]);
+        undoMove(board, moves[best]);
+    }
+
+    if (engine->searchState != SEARCH_STOPPED)
+        mateTableStore(board->hash, depth, *phi, *delta);
+}
+
+// Solves a node outright
+static void solve(Engine *engine, int depth, uint32_t *phi, uint32_t *delta) {
+    initNode(&engine->board, depth, phi, delta);
+    if (*phi != 0 && *delta != 0)
+        mid(engine, depth, MATE_INF, MATE_INF, phi, delta);
+}
+
+/* -------------------------------------------------------------------------- */
+/*                             Principal variation                            */
+/* -------------------------------------------------------------------------- */
+
+// The move of the child with the smallest delta
+static Move mostProvingMove(Engine *engine, int depth, uint32_t *bestDelta) {
+    Board *board = &engine->board;
+    Move moves[MAX_LEGAL_MOVES];
+    int count = nodeMoves(board, depth, moves);
+
+    Move bestMove = NO_MOVE;
+    *bestDelta = MATE_INF + 1;
+    for (int i = 0; i < count; i++) {
+        uint32_t phi, delta;
+        makeMove(board, moves[i]);
+        initNode(board, depth - 1, &phi, &delta);
+        undoMove(board, moves[i]);
+
+        if (delta < *bestDelta) {
+            bestMove = moves[i];
+            *bestDelta = delta;
+        }
+    }
+
+    return bestMove;
+}
+
+// A move which mates in the plies left. Children are solved again if the table lost them.
+static Move matingMove(Engine *engine, int depth) {
+    uint32_t phi, delta;
+    Move move = mostProvingMove(engine, depth, &delta);
+    if (move == NO_MOVE || delta == 0)
+        return move;
+
+    Board *board = &engine->board;
+    Move moves[MAX_LEGAL_MOVES];
+    int count = nodeMoves(board, depth, moves);
+
+    for (int i = 0; i < count; i++) {
+        makeMove(board, moves[i]);
+        solve(engine, depth - 1, &phi, &delta);
+        undoMove(board, moves[i]);
+
+        if (delta == 0)
+            return moves[i];
+    }
+
+    return NO_MOVE;
+}
+
+// A reply which can't be mated in fewer plies than are left
+static Move longestDefence(Engine *engine, int depth) {
+    Board *board = &engine->board;
+    Move moves[MAX_LEGAL_MOVES];
+    int count = nodeMoves(board, depth, moves);
+
+    for (int i = 0; i < count && depth >= 4; i++) {
+        uint32_t phi, delta;
+        makeMove(board, moves[i]);
+        solve(engine, depth - 3, &phi, &delta);
+        undoMove(board, moves[i]);
+
+        if (phi != 0)
+            return moves[i];
+    }
+
+    return count ? moves[0] : NO_MOVE;
+}
+
+static void buildMatePV(Engine *engine, int depth) {
+    Board *board = &engine->board;
+    PV *pv = &engine->pv;
+    pv->length = 0;
+
+    for (; depth > 0 && engine->searchState != SEARCH_STOPPED; depth--) {
+        Move move = attackerToMove(depth) ? matingMove(engine, depth) : longestDefence(engine, depth);
+        if (move == NO_MOVE)
+            break;
+
+        pv->moves[pv->length++] = move;
+        makeMove(board, move);
+    }
+
+    for (int i = pv->length - 1; i >= 0; i--)
+        undoMove(board, pv->moves[i]);
+}
+
+/* -------------------------------------------------------------------------- */
+/*                                 Root search                                */
+/* -------------------------------------------------------------------------- */
+
+static void printMateInfo(Engine *engine, int depth, int moves) {
+    printf("info depth %d ", depth);
+    if (moves)
+        printf("score mate %d ", moves);
+    printf("nodes %" PRIu64 " ", engine->searchStats.nodes);
+    printf("time %d", getTime() - engine->searchStats.searchStartTime);
+
+    if (engine->pv.length > 0) {
+        printf(" pv");
+        for (int i = 0; i < engine->pv.length; i++)
+            printf(" %s", moveToString(engine->pv.moves[i]));
+    }
+
+    printf("\n");
+    fflush(stdout);
+}
+
+/**
+ * Searches for a mate in up to the given number of moves, and returns the
+ * first move of the shortest one found. A mate is found fastest with all the
+ * moves allowed, so that is searched first, and then one move less at a time
+ * until there is none. Without a mate, returns the most promising try.
+ */
+Move mateSearch(Engine *engine, int moves) {
+    clearMateTable();
+    engine->pv.length = 0;
+    moves = MIN(moves, MATE_MAX_MOVES);
+
+    // Line of the last pass which finished, a PV cut short by a stop proves nothing
+    PV matePV = {0};
+    Move bestMove = NO_MOVE;
+    for (int m = moves; m >= 1; m--) {
+        int depth = 2 * m - 1;
+        uint32_t phi, delta;
+        mid(engine, depth, MATE_INF, MATE_INF, &phi, &delta);
+
+        if (engine->searchState == SEARCH_STOPPED || phi != 0)
+            break;
+
+        buildMatePV(engine, depth);
+        if (engine->searchState == SEARCH_STOPPED)
+            break;
+
+        matePV = engine->pv;
+        if (matePV.length)
+            bestMove = matePV.moves[0];
+        if (!engine->silent)
+            printMateInfo(engine, depth, (matePV.length + 1) / 2);
+    }
+    engine->pv = matePV;
+    engine->searchState = SEARCH_STOPPED;
+
+    if (bestMove != NO_MOVE)
+        return bestMove;
+
+    // Without a mate, play the most promising try, or any legal move
+    uint32_t delta;
+    bestMove = mostProvingMove(engine, 2 * MAX(moves, 1) - 1, &delta);
+    if (bestMove != NO_MOVE)
+        return bestMove;
+
+    Move legal[MAX_LEGAL_MOVES];
+    return nodeMoves(&engine->board, 2, legal) ? legal[0] : NO_MOVE;
+}
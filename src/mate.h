@@ -0,0 +1,31 @@
+// Mate search for "go mate N".
+//
+// A depth-first proof-number search (df-pn) for a forced mate in at most N
+// moves by the side to move. Every node keeps a proof number (how many leaves
+// still have to be shown to be won to prove the mate) and a disproof number
+// (how many to show there is no mate), and the search always goes down the
+// most proving line, until its numbers go over thresholds handed down from
+// its parent. Forcing lines, such as checks which leave the defender few
+// replies, get solved first without having to search every other move to the
+// same depth the way iterative deepening does.
+//
+// Numbers are stored for the side to move (phi, delta): at the attacker's
+// nodes these are the proof and disproof numbers, at the defender's they're
+// the other way around. They're kept in the search's own table with a small
+// entry per position, apart from the main hash table.
+//
+// A mate in N moves is searched first, then in N-1, N-2 ... until there is
+// none, so the last mate found is the shortest one.
+
+#pragma once
+
+#include "uci.h"
+#include "move.h"
+
+// Size of the proof number table
+#define MATE_HASH_SIZE_MB 64
+
+// Longest mate that can be asked for
+#define MATE_MAX_MOVES 50
+
+Move mateSearch(Engine *engine, int moves);
@@ -0,0 +1,298 @@
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "material.h"
+#include "bitbase.h"
+#include "board.h"
+#include "bitboards.h"
+#include "eval.h"
+#include "utils.h"
+
+#define LIGHT_SQUARES 0x55AA55AA55AA55AAULL
+
+/* -------------------------------------------------------------------------- */
+/*                                Material Key                                */
+/* -------------------------------------------------------------------------- */
+
+// Material key computed from scratch, used to verify the board's copy.
+U64 computeMaterialKey(Board *board) {
+    U64 key = 0ULL;
+
+    for (int color = WHITE; color <= BLACK; color++) {
+        for (int piece = PAWN; piece <= KING; piece++) {
+            int count = popCount(board->pieces[piece] & board->colors[color]);
+            key += count * MATERIAL_KEY(toPiece(piece, color));
+        }
+    }
+
+    return key;
+}
+
+// Number of pieces of a type and color in a material key
+static inline int countOf(U64 key, int color, int piece) {
+    return MaterialCount(key, toPiece(piece, color));
+}
+
+// Midgame value of all the non pawn material of a color in a material key
+static int nonPawnMaterial(U64 key, int color) {
+    int material = 0;
+    for (int piece = KNIGHT; piece <= QUEEN; piece++)
+        material += countOf(key, color, piece) * ScoreMG(MATERIAL_VALUES[piece]);
+
+    return material;
+}
+
+/* -------------------------------------------------------------------------- */
+/*                              Endgame Functions                             */
+/* -------------------------------------------------------------------------- */
+
+// Chebyshev distance between two squares, the number of king moves between them
+static int distance(int sq1, int sq2) {
+    return MAX(abs(fileOf(sq1) - fileOf(sq2)), abs(rankOf(sq1) - rankOf(sq2)));
+}
+
+// Manhattan distance of a square to the center, from 0 to 6
+static int centerDistance(int sq) {
+    int file = fileOf(sq);
+    int rank = rankOf(sq);
+    return (file < 4 ? 3 - file : file - 4) + (rank < 4 ? 3 - rank : rank - 4);
+}
+
+// Bonus for driving the weak king to the edge and keeping our king close to it
+static int mateBonus(int strongKing, int weakKing) {
+    return 20 * centerDistance(weakKing) + 20 * (7 - distance(strongKing, weakKing));
+}
+
+static int kingSquare(Board *board, int color) {
+    return getlsb(board->pieces[KING] & board->colors[color]);
+}
+
+/**
+ * KXK: the strong side has enough material to mate a bare king. All that is
+ * left is to drive the king to the edge and bring our own king closer, which
+ * the normal evaluation has no idea about.
+ */
+static int evaluateKXK(Board *board, int strongSide) {
+    int weakSide = !strongSide;
+    U64 strong = board->colors[strongSide];
+
+    int eval = mateBonus(kingSquare(board, strongSide), kingSquare(board, weakSide));
+    for (int piece = PAWN; piece <= QUEEN; piece++)
+        eval += popCount(board->pieces[piece] & strong) * ScoreEG(MATERIAL_VALUES[piece]);
+
+    // Bishops on the same color can't mate without help
+    U64 bishops = board->pieces[BISHOP] & strong;
+    bool canMate = (board->pieces[PAWN] | board->pieces[KNIGHT] | board->pieces[ROOK] | board->pieces[QUEEN]) & strong
+                || ((bishops & LIGHT_SQUARES) && (bishops & ~LIGHT_SQUARES));
+
+    return canMate ? KNOWN_WIN + eval : eval;
+}
+
+/**
+ * KBNK: the mate can only be forced in a corner of the bishop's color, so the
+ * weak king is driven there instead of to any edge.
+ */
+static int evaluateKBNK(Board *board, int strongSide) {
+    int strongKing = kingSquare(board, strongSide);
+    int weakKing = kingSquare(board, !strongSide);
+
+    // Mirror the board vertically for light squared bishops, so A1 and H8 are the right corners
+    if (board->pieces[BISHOP] & LIGHT_SQUARES) {
+        strongKing = MIRROR_SQ(strongKing);
+        weakKing = MIRROR_SQ(weakKing);
+    }
+
+    int cornerDistance = MIN(fileOf(weakKing) + rankOf(weakKing), 14 - fileOf(weakKing) - rankOf(weakKing));
+    int eval = KNOWN_WIN + ScoreEG(MATERIAL_VALUES[KNIGHT]) + ScoreEG(MATERIAL_VALUES[BISHOP]);
+    return eval + 20 * (14 - cornerDistance) + 20 * (7 - distance(strongKing, weakKing));
+}
+
+/**
+ * Simple rules for drawn KPK positions, seen from the strong side with the
+ * pawn going up. checkKPKRules verifies them against the bitbase.
+ */
+static bool kpkDrawn(int pawn, int strongKing, int weakKing) {
+    // Rook pawns are drawn once the defending king gets to the queening corner
+    int queeningSquare = squareFrom(fileOf(pawn), 7);
+    if ((fileOf(pawn) == 0 || fileOf(pawn) == 7) && distance(weakKing, queeningSquare) <= 1)
+        return true;
+
+    // The defending king stands one or two squares in front of the pawn, and our king is still
+    // behind it. On the last rank the defending king has no room left and can be pushed aside.
+    int ahead = rankOf(weakKing) - rankOf(pawn);
+    return fileOf(weakKing) == fileOf(pawn) && (ahead == 1 || ahead == 2) && rankOf(weakKing) < 7
+        && rankOf(strongKing) < rankOf(pawn);
+}
+
+/**
+ * KPK: exact with the bitbase, otherwise a few simple rules for drawn
+ * positions. Everything else is left to the normal evaluation of the passed pawn.
+ */
+static int scaleKPK(Board *board, int strongSide) {
+    int result = bitbasePieces ? probeBitbase(board) : BITBASE_UNKNOWN;
+    if (result != BITBASE_UNKNOWN)
+        return result == BITBASE_DRAW ? SCALE_DRAW : SCALE_NONE;
+
+    int pawn = getlsb(board->pieces[PAWN]);
+    int strongKing = kingSquare(board, strongSide);
+    int weakKing = kingSquare(board, !strongSide);
+
+    // Look at the board from the strong side, with the pawn going up
+    if (strongSide == BLACK) {
+        pawn = MIRROR_SQ(pawn);
+        strongKing = MIRROR_SQ(strongKing);
+        weakKing = MIRROR_SQ(weakKing);
+    }
+
+    return kpkDrawn(pawn, strongKing, weakKing) ? SCALE_DRAW : SCALE_NONE;
+}
+
+/**
+ * Goes through every KPK position with a white pawn and counts those the rules
+ * call drawn, and how many of them the loaded bitbase says are won.
+ */
+void checkKPKRules() {
+    if (bitbasePieces < 3) {
+        puts("KPK rules need the KPK bitbase loaded");
+        return;
+    }
+
+    Board board;
+    int draws = 0, wins = 0;
+
+    for (int side = WHITE; side <= BLACK; side++) {
+        for (int pawn = 8; pawn < 56; pawn++) {
+            for (int strongKing = 0; strongKing < 64; strongKing++) {
+                for (int weakKing = 0; weakKing < 64; weakKing++) {
+                    // Pieces on top of each other, touching kings, or Black in check with White to move
+                    if (strongKing == pawn || weakKing == pawn || distance(strongKing, weakKing) <= 1
+                        || (side == WHITE && testBit(pawnAttacks(WHITE, pawn), weakKing)))
+                        continue;
+
+                    if (!kpkDrawn(pawn, strongKing, weakKing))
+                        continue;
+
+                    clearBoard(&board);
+                    setPiece(&board, WHITE, KING, strongKing);
+                    setPiece(&board, BLACK, KING, weakKing);
+                    setPiece(&board, WHITE, PAWN, pawn);
+                    board.side = side;
+
+                    int result = probeBitbase(&board);
+                    draws++;
+                    wins += result == (side == WHITE ? BITBASE_WIN : BITBASE_LOSS);
+                }
+            }
+        }
+    }
+
+    printf("KPK rules: %d positions called drawn, %d of them won\n", draws, wins);
+}
+
+/**
+ * Opposite colored bishops, with no other pieces, are very drawish even a pawn
+ * or two up. Bishop colors aren't part of the material key, so this is checked
+ * when scaling.
+ */
+static int scaleOppositeBishops(Board *board, int strongSide) {
+    if (popCount(board->pieces[BISHOP] & LIGHT_SQUARES) != 1)
+        return SCALE_NONE;
+
+    int pawns = popCount(board->pieces[PAWN] & board->colors[strongSide]);
+    return MIN(SCALE_NORMAL, 16 + 4 * pawns);
+}
+
+/* -------------------------------------------------------------------------- */
+/*                               Material Table                               */
+/* -------------------------------------------------------------------------- */
+
+/**
+ * Material changes even less often than the pawns, so the material table is
+ * small and almost always hits. Each thread has its own.
+ */
+#define MATERIAL_TABLE_SIZE (1 << 13)
+
+static _Thread_local MaterialEntry materialTable[MATERIAL_TABLE_SIZE];
+
+// Works out what we know about a material configuration.
+static void initMaterialEntry(MaterialEntry *entry, U64 key) {
+    entry->key = key;
+    entry->evaluate = NULL;
+    entry->strongSide = WHITE;
+    entry->special = false;
+
+    for (int strong = WHITE; strong <= BLACK; strong++) {
+        int weak = !strong;
+        int strongMaterial = nonPawnMaterial(key, strong);
+        int weakMaterial = nonPawnMaterial(key, weak);
+        int strongPawns = countOf(key, strong, PAWN);
+
+        entry->scale[strong] = NULL;
+        entry->factor[strong] = SCALE_NORMAL;
+
+        // Endgames against a bare king
+        if (weakMaterial == 0 && countOf(key, weak, PAWN) == 0) {
+            bool isKBNK = strongPawns == 0
+                && countOf(key, strong, KNIGHT) == 1 && countOf(key, strong, BISHOP) == 1
+                && strongMaterial == ScoreMG(MATERIAL_VALUES[KNIGHT]) + ScoreMG(MATERIAL_VALUES[BISHOP]);
+            bool canMate = countOf(key, strong, QUEEN) || countOf(key, strong, ROOK)
+                || (countOf(key, strong, BISHOP) && countOf(key, strong, KNIGHT))
+                || countOf(key, strong, BISHOP) >= 2;
+
+            if (isKBNK || canMate) {
+                entry->evaluate = isKBNK ? evaluateKBNK : evaluateKXK;
+                entry->strongSide = strong;
+            } else if (strongPawns == 1 && strongMaterial == 0) {
+                entry->scale[strong] = scaleKPK;
+            }
+        }
+
+        /**
+         * Without pawns, being up less than a bishop is hard to win, and
+         * impossible without at least a rook's worth of material.
+         */
+        if (strongPawns == 0 && strongMaterial - weakMaterial <= ScoreMG(MATERIAL_VALUES[BISHOP])) {
+            entry->factor[strong] = strongMaterial < ScoreMG(MATERIAL_VALUES[ROOK]) ? SCALE_DRAW
+                                  : weakMaterial <= ScoreMG(MATERIAL_VALUES[BISHOP]) ? 4 : 14;
+        }
+
+        // A single bishop each and no other pieces
+        if (countOf(key, strong, BISHOP) == 1 && countOf(key, weak, BISHOP) == 1
+            && strongMaterial == ScoreMG(MATERIAL_VALUES[BISHOP])
+            && weakMaterial == ScoreMG(MATERIAL_VALUES[BISHOP])) {
+            entry->scale[strong] = scaleOppositeBishops;
+        }
+
+        if (entry->scale[strong] || entry->factor[strong] != SCALE_NORMAL)
+            entry->special = true;
+    }
+
+    if (entry->evaluate)
+        entry->special = true;
+}
+
+// Looks up the material table entry of the current board.
+MaterialEntry *probeMaterial(Board *board) {
+    assert(board->materialKey == computeMaterialKey(board));
+
+    // The key is a sum of counts, so mix it up before using it as an index
+    U64 index = (board->materialKey * 0x9E3779B97F4A7C15ULL) >> 51;
+    MaterialEntry *entry = &materialTable[index % MATERIAL_TABLE_SIZE];
+
+    if (entry->key != board->materialKey || entry->key == 0ULL)
+        initMaterialEntry(entry, board->materialKey);
+
+    return entry;
+}
+
+// Endgame scale factor for when the strong side is ahead, out of SCALE_NORMAL.
+int scaleFactor(Board *board, MaterialEntry *entry, int strongSide) {
+    if (entry->scale[strongSide]) {
+        int factor = entry->scale[strongSide](board, strongSide);
+        if (factor != SCALE_NONE)
+            return factor;
+    }
+
+    return entry->factor[strongSide];
+}
@@ -0,0 +1,47 @@
+// Material configurations and endgame knowledge.
+//
+// Every combination of pieces on the board has a material key, kept up to date
+// by the board like the hash. The material table maps these keys to what we
+// know about that combination of material: a specialized evaluation function
+// for endgames which the normal evaluation plays badly (KXK, KBNK), functions
+// which detect drawish cases (KPK, opposite colored bishops), and scale factors
+// for the endgame score when the stronger side doesn't have enough to win.
+// https://www.chessprogramming.org/Material_Hash_Table
+
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "board.h"
+
+// Endgame scale factors, out of SCALE_NORMAL
+#define SCALE_DRAW 0
+#define SCALE_NORMAL 64
+#define SCALE_NONE 255
+
+// Score for positions which are known to be won, more than any normal eval
+#define KNOWN_WIN 10000
+
+// Piece count for a colored piece from a material key
+#define MaterialCount(key, coloredPiece) ((int)(((key) >> (4 * (coloredPiece))) & 15))
+
+/**
+ * Evaluation of a known endgame from the stronger side's POV, or a scale
+ * factor for it (SCALE_NONE if it doesn't know this position).
+ */
+typedef int (*EndgameFunction)(Board *board, int strongSide);
+
+typedef struct {
+    U64 key;
+    EndgameFunction evaluate;  // Replaces the whole evaluation, if there is one
+    int strongSide;            // Side the evaluation function is for
+    EndgameFunction scale[2];  // Scale factor function for each side as the stronger one
+    uint8_t factor[2];         // Fallback scale factor for each side as the stronger one
+    bool special;              // Whether any of the above isn't the default
+} MaterialEntry;
+
+MaterialEntry *probeMaterial(Board *board);
+int scaleFactor(Board *board, MaterialEntry *entry, int strongSide);
+U64 computeMaterialKey(Board *board);
+void checkKPKRules();
@@ -0,0 +1,386 @@
+#include <inttypes.h>
+#include <math.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "mcts.h"
+#include "board.h"
+#include "hashtable.h"
+#include "makemove.h"
+#include "movegen.h"
+#include "search.h"
+#include "timeman.h"
+#include "utils.h"
+
+// Values are summed as fixed point win probabilities
+#define MCTS_VALUE_SCALE 65536
+
+// Node states
+enum {
+    NODE_LEAF,                // Not expanded yet
+    NODE_EXPANDING,           // Being expanded by a thread, evaluated as a leaf meanwhile
+    NODE_EXPANDED,
+    NODE_MATED,               // No legal moves, in check
+    NODE_STALEMATE            // No legal moves, not in check
+};
+
+// Tree node (24 bytes). Values are for the side which made the move into it.
+typedef struct {
+    _Atomic uint64_t valueSum;
+    _Atomic uint32_t visits;
+    _Atomic uint32_t virtualLoss;
+    uint32_t firstChild;      // Index of the first child in the pool, children are consecutive
+    Move move;                // Move into this node
+    uint8_t childCount;
+    _Atomic uint8_t state;
+} MctsNode;
+
+typedef struct {
+    MctsNode *nodes;          // Node pool, the root is the first node
+    uint32_t capacity;
+    atomic_uint next;         // First node of the pool which isn't taken yet
+    atomic_bool stop;
+    atomic_uint_fast64_t searched; // Nodes searched by the rollouts
+} MctsTree;
+
+typedef struct {
+    MctsTree *tree;
+    Engine *engine;           // Own board and search stack for rollouts
+} MctsThread;
+
+static MctsNode *pool = NULL;
+
+/* -------------------------------------------------------------------------- */
+/*                                    Nodes                                   */
+/* -------------------------------------------------------------------------- */
+
+static inline double nodeValue(MctsNode *node, uint32_t visits) {
+    return (double) atomic_load(&node->valueSum) / MCTS_VALUE_SCALE / visits;
+}
+
+static inline double winProbability(int score) {
+    return 1.0 / (1.0 + pow(10.0, -score / MCTS_SCORE_SCALE));
+}
+
+static inline MctsNode *childOf(MctsTree *tree, MctsNode *node, int i) {
+    return &tree->nodes[node->firstChild + i];
+}
+
+/**
+ * Gives a node a child for each legal move, or marks it mated or stalemated.
+ * Left as a leaf if the pool is full.
+ */
+static void expand(MctsTree *tree, MctsNode *node, Board *board) {
+    MoveList moves;
+    generatePseudoLegalMoves(&moves, board);
+
+    Move legal[MAX_LEGAL_MOVES];
+    int count = 0;
+    for (int i = 0; i < moves.count; i++) {
+        if (makeMove(board, moves.list[i]))
+            legal[count++] = moves.list[i];
+        undoMove(board, moves.list[i]);
+    }
+
+    if (count == 0) {
+        atomic_store(&node->state, boardIsInCheck(board) ? NODE_MATED : NODE_STALEMATE);
+        return;
+    }
+
+    uint32_t first = atomic_fetch_add(&tree->next, count);
+    if (first + count > tree->capacity) {
+        atomic_store(&node->state, NODE_LEAF);
+        return;
+    }
+
+    for (int i = 0; i < count; i++) {
+        MctsNode *child = &tree->nodes[first + i];
+        atomic_init(&child->valueSum, 0);
+        atomic_init(&child->visits, 0);
+        atomic_init(&child->virtualLoss, 0);
+        atomic_init(&child->state, NODE_LEAF);
+        child->move = legal[i];
+        child->childCount = 0;
+    }
+
+    node->firstChild = first;
+    node->childCount = count;
+    atomic_store(&node->state, NODE_EXPANDED);
+}
+
+/**
+ * Picks the child with the highest UCT value. Virtual losses count as visits
+ * which lost, and unvisited children are assumed to be a bit worse than their
+ * parent (first play urgency).
+ */
+static MctsNode *selectChild(MctsTree *tree, MctsNode *node) {
+    uint32_t visits = atomic_load(&node->visits);
+    uint32_t parentVisits = visits + atomic_load(&node->virtualLoss);
+    double firstPlay = (visits ? 1.0 - nodeValue(node, visits) : 0.5) - MCTS_FPU_REDUCTION;
+    double exploration = MCTS_EXPLORATION * sqrt(log(parentVisits + 1));
+
+    MctsNode *best = NULL;
+    double bestValue = -INFINITY;
+    for (int i = 0; i < node->childCount; i++) {
+        MctsNode *child = childOf(tree, node, i);
+        uint32_t childVisits = atomic_load(&child->visits) + atomic_load(&child->virtualLoss);
+
+        double value = childVisits ? nodeValue(child, childVisits) : firstPlay;
+        value += exploration / sqrt(childVisits + 1);
+
+        if (value > bestValue) {
+            best = child;
+            bestValue = value;
+        }
+    }
+
+    return best;
+}
+
+/* -------------------------------------------------------------------------- */
+/*                                  Playouts                                  */
+/* -------------------------------------------------------------------------- */
+
+// Evaluates the engine's board with a rollout, for the side which moved into it.
+// Histories carry over between rollouts, they're only aged once per go.
+static double rollout(MctsThread *thread) {
+    Engine *engine = thread->engine;
+
+    SearchLimits limits = {0};
+    limits.depth = MCTS_ROLLOUT_DEPTH;
+    limits.nodes = MCTS_ROLLOUT_NODES;
+    limits.searchType = LIMIT_NODES;
+
+    resetSearch(engine, limits);
+    int score = rolloutSearch(engine, MCTS_ROLLOUT_DEPTH);
+    atomic_fetch_add(&thread->tree->searched, engine->searchStats.nodes);
+
+    return 1.0 - winProbability(score);
+}
+
+// Walks down the tree from the root to a leaf, evaluates it, and backs the value up
+static void playout(MctsThread *thread) {
+    MctsTree *tree = thread->tree;
+    Board *board = &thread->engine->board;
+
+    MctsNode *path[MCTS_MAX_DEPTH + 1];
+    int length = 0;
+    MctsNode *node = &tree->nodes[0];
+    double value;
+
+    while (true) {
+        path[length++] = node;
+        atomic_fetch_add(&node->virtualLoss, 1);
+
+        int state = atomic_load(&node->state);
+        if (state == NODE_MATED) {
+            value = 1.0;
+            break;
+        }
+        if (state == NODE_STALEMATE || (length > 1 && isDraw(board, length - 1))) {
+            value = 0.5;
+            break;
+        }
+
+        // Leaves are expanded on their second visit, the first only evaluates them
+        if (state == NODE_LEAF && atomic_load(&node->visits) > 0 && length <= MCTS_MAX_DEPTH
+            && atomic_load(&tree->next) < tree->capacity) {
+            uint8_t expected = NODE_LEAF;
+            if (atomic_compare_exchange_strong(&node->state, &expected, NODE_EXPANDING)) {
+                expand(tree, node, board);
+                state = atomic_load(&node->state);
+                if (state != NODE_EXPANDED) {
+                    length--;
+                    atomic_fetch_sub(&node->virtualLoss, 1);
+                    continue;
+                }
+            }
+        }
+
+        if (state != NODE_EXPANDED || length > MCTS_MAX_DEPTH) {
+            value = rollout(thread);
+            break;
+        }
+
+        node = selectChild(tree, node);
+        makeMove(board, node->move);
+    }
+
+    for (int i = length - 1; i >= 0; i--) {
+        atomic_fetch_add(&path[i]->visits, 1);
+        atomic_fetch_add(&path[i]->valueSum, (uint64_t) (value * MCTS_VALUE_SCALE));
+        atomic_fetch_sub(&path[i]->virtualLoss, 1);
+        value = 1.0 - value;
+
+        if (i > 0)
+            undoMove(board, path[i]->move);
+    }
+}
+
+static void *mctsWorker(void *arg) {
+    MctsThread *thread = arg;
+    initHashTable(MCTS_HASH_MB);
+
+    while (!atomic_load(&thread->tree->stop))
+        playout(thread);
+
+    cleanUpHashTable();
+    return NULL;
+}
+
+/* -------------------------------------------------------------------------- */
+/*                                 Root search                                */
+/* -------------------------------------------------------------------------- */
+
+static MctsNode *mostVisitedChild(MctsTree *tree, MctsNode *node) {
+    if (atomic_load(&node->state) != NODE_EXPANDED)
+        return NULL;
+
+    MctsNode *best = NULL;
+    for (int i = 0; i < node->childCount; i++) {
+        MctsNode *child = childOf(tree, node, i);
+        if (best == NULL || atomic_load(&child->visits) > atomic_load(&best->visits))
+            best = child;
+    }
+
+    return best;
+}
+
+// The principal variation is the line of most visited children
+static void buildPV(MctsTree *tree, PV *pv) {
+    pv->length = 0;
+    MctsNode *node = mostVisitedChild(tree, &tree->nodes[0]);
+
+    while (node != NULL && atomic_load(&node->visits) > 0 && pv->length < MAX_PLY) {
+        pv->moves[pv->length++] = node->move;
+        node = mostVisitedChild(tree, node);
+    }
+}
+
+// Score of the most visited move, from the win probability of its visits
+static int rootScore(MctsTree *tree) {
+    MctsNode *best = mostVisitedChild(tree, &tree->nodes[0]);
+    uint32_t visits = atomic_load(&best->visits);
+
+    if (atomic_load(&best->state) == NODE_MATED)
+        return MATE_SCORE - 1;
+
+    double value = visits ? nodeValue(best, visits) : 0.5;
+    value = MIN(MAX(value, 0.001), 0.999);
+    return (int) round(-MCTS_SCORE_SCALE * log10(1.0 / value - 1.0));
+}
+
+static void printMctsInfo(Engine *engine, MctsTree *tree) {
+    U64 nodes = atomic_load(&tree->searched);
+    int timeTaken = getTime() - engine->searchStats.searchStartTime;
+    int score = rootScore(tree);
+
+    printf("info depth %d ", engine->pv.length);
+    if (isMateScore(score))
+        printf("score mate 1 ");
+    else
+        printf("score cp %d ", score);
+
+    printf("nodes %" PRIu64 " ", nodes);
+    printf("nps %" PRIu64 " ", nodes * 1000 / MAX(timeTaken, 1));
+    printf("time %d ", timeTaken);
+
+    printf("pv");
+    for (int i = 0; i < engine->pv.length; i++)
+        printf(" %s", moveToString(engine->pv.moves[i]));
+
+    printf("\n");
+    fflush(stdout);
+}
+
+// Whether the main thread should stop the search, checks every limit of the engine's
+static bool mctsSearchOver(Engine *engine, MctsTree *tree) {
+    engine->searchStats.nodes = atomic_load(&tree->searched);
+
+    if (checkSearchOver(engine) || timeSoftBoundReached(&engine->limits))
+        return true;
+
+    return engine->limits.searchType == LIMIT_DEPTH && engine->pv.length >= engine->limits.depth;
+}
+
+/**
+ * Grows the tree from the engine's board with Threads threads until the
+ * engine's limits are reached, and returns the most visited move.
+ */
+Move mctsSearch(Engine *engine) {
+    if (pool == NULL)
+        pool = malloc((size_t) MCTS_POOL_SIZE_MB * 1024 * 1024);
+
+    MctsTree tree;
+    tree.nodes = pool;
+    tree.capacity = (size_t) MCTS_POOL_SIZE_MB * 1024 * 1024 / sizeof(MctsNode);
+    atomic_init(&tree.next, 1);
+    atomic_init(&tree.stop, false);
+    atomic_init(&tree.searched, 0);
+
+    MctsNode *root = &tree.nodes[0];
+    atomic_init(&root->valueSum, 0);
+    atomic_init(&root->visits, 0);
+    atomic_init(&root->virtualLoss, 0);
+    atomic_init(&root->state, NODE_LEAF);
+    root->childCount = 0;
+    root->move = NO_MOVE;
+
+    expand(&tree, root, &engine->board);
+    if (atomic_load(&root->state) != NODE_EXPANDED) {
+        engine->searchState = SEARCH_STOPPED;
+        return NO_MOVE;
+    }
+
+    // Every thread searches its own copy of the board, thread 0 is this one
+    int threadCount = MAX(searchThreads, 1);
+    MctsThread *threads = malloc(threadCount * sizeof(MctsThread));
+    pthread_t *handles = malloc(threadCount * sizeof(pthread_t));
+    for (int i = 0; i < threadCount; i++) {
+        threads[i].tree = &tree;
+        threads[i].engine = malloc(sizeof(Engine));
+        threads[i].engine->board = engine->board;
+        threads[i].engine->silent = true;
+        threads[i].engine->pollInput = false;
+    }
+
+    for (int i = 1; i < threadCount; i++)
+        pthread_create(&handles[i], NULL, mctsWorker, &threads[i]);
+
+    int lastReport = getTime();
+    for (int playouts = 1; ; playouts++) {
+        playout(&threads[0]);
+
+        if (playouts % 16)
+            continue;
+
+        buildPV(&tree, &engine->pv);
+        if (mctsSearchOver(engine, &tree))
+            break;
+
+        if (!engine->silent && getTime() - lastReport >= MCTS_REPORT_INTERVAL) {
+            printMctsInfo(engine, &tree);
+            lastReport = getTime();
+        }
+    }
+
+    atomic_store(&tree.stop, true);
+    for (int i = 1; i < threadCount; i++)
+        pthread_join(handles[i], NULL);
+
+    engine->searchState = SEARCH_STOPPED;
+    engine->searchStats.score = rootScore(&tree);
+    buildPV(&tree, &engine->pv);
+    if (!engine->silent)
+        printMctsInfo(engine, &tree);
+
+    for (int i = 0; i < threadCount; i++)
+        free(threads[i].engine);
+    free(handles);
+    free(threads);
+
+    return engine->pv.moves[0];
+}
@@ -0,0 +1,46 @@
+// Monte Carlo tree search with alpha-beta rollouts.
+//
+// A best-first alternative to iterative deepening, selected with the
+// SearchMode UCI option. The tree grows by one node per playout: a playout
+// walks down from the root picking the child with the highest UCT value,
+// expands the leaf it reaches, and evaluates it with a shallow alpha-beta
+// search (the rollout) instead of playing a random game. The score, turned
+// into a win probability, is backed up along the path.
+//
+// Every thread of the Threads option plays out into the same tree, and nodes
+// come from one preallocated pool. A thread going through a node adds a
+// virtual loss to it until its result is backed up, so the other threads
+// spread over other lines instead of all following the same one. Each thread
+// has its own board, hash table and histories for its rollouts.
+
+#pragma once
+
+#include "uci.h"
+#include "move.h"
+
+// Size of the node pool, the tree stops growing once it's full
+#define MCTS_POOL_SIZE_MB 128
+
+// Hash size of each helper thread, the main thread uses the main hash table
+#define MCTS_HASH_MB 16
+
+// Rollouts search to this depth, giving up on deeper iterations after MCTS_ROLLOUT_NODES.
+// Search only checks its limits every 4096 nodes, so with this node limit the check
+// always stops the rollout.
+#define MCTS_ROLLOUT_DEPTH 3
+#define MCTS_ROLLOUT_NODES 4096
+
+// Deepest the tree grows, leaving room on the board's stacks for the rollout
+#define MCTS_MAX_DEPTH 32
+
+// UCT exploration constant, and how much worse than its parent an unvisited child is assumed to be
+#define MCTS_EXPLORATION 0.5
+#define MCTS_FPU_REDUCTION 0.1
+
+// Scale of the logistic curve turning scores into win probabilities
+#define MCTS_SCORE_SCALE 400.0
+
+// How often the main thread prints info lines, in ms
+#define MCTS_REPORT_INTERVAL 1000
+
+Move mctsSearch(Engine *engine);
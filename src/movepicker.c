@@ -7,16 +7,19 @@
 #include "board.h"
 #include "eval.h"
 #include "search.h"
+#include "magicmoves.h"
+#include "utils.h"
 
 /* -------------------------------------------------------------------------- */
 /*                                 Move Scorer                                */
 /* -------------------------------------------------------------------------- */
 
-// killers[side][ply]
-Move killers[2][MAX_PLY];
-
+// Move ordering histories are per thread, like the hash table
 // history[side][piece][to]
-int history[2][NB_PIECES][64];
+_Thread_local int16_t history[2][NB_PIECES][64];
+
+// continuationHistory[previous colored piece][previous to][colored piece][to]
+_Thread_local PieceToHistory continuationHistory[NB_PIECES * 2][64];
 
 // https://www.chessprogramming.org/MVV-LVA
 // MVV_LVA[victim][attacker]
@@ -33,6 +36,23 @@ void initMvvLva() {
     }
 }
 
+// Sums the butterfly history and the continuation histories of a quiet move
+static int quietHistory(Board *board, PieceToHistory *continuations[2], Move move) {
+    int piece = board->squares[MoveFrom(move)];
+    int to    = MoveTo(move);
+
+    // History heuristic
+    int score = history[board->side][piece][to];
+
+    // Continuation history, from the moves made one and two plies ago
+    for (int i = 0; i < 2; i++) {
+        if (continuations[i] != NULL)
+            score += (*continuations[i])[toPiece(piece, board->side)][to];
+    }
+
+    return score;
+}
+
 // Returns the score of a move for ordering
 int scoreMove(MovePicker *picker, Move move, Board *board) {
     if (IsCapture(move)) {
@@ -55,67 +75,173 @@ int scoreMove(MovePicker *picker, Move move, Board *board) {
     if (move == picker->killerOne) return KILLER_ONE_BONUS;
     if (move == picker->killerTwo) return KILLER_TWO_BONUS;
 
-    // History heuristic
-    int score = history[board->side][board->squares[MoveFrom(move)]][MoveTo(move)];
-
-    return score;
-}
-
-// Clears the killer table
-void clearKillerMoves() {
-    memset(killers, NO_MOVE, sizeof(killers));
+    // History heuristics
+    return quietHistory(board, picker->continuationHistory, move);
 }
 
 /* -------------------------------------------------------------------------- */
 /*                                Move History                                */
 /* -------------------------------------------------------------------------- */
 
-// Clears the move history table
+// Clears the move history tables
 void clearMoveHistory() {
     memset(history, 0, sizeof(history));
+    memset(continuationHistory, 0, sizeof(continuationHistory));
+}
+
+/**
+ * Ages the move history tables by halving every entry. The history from the
+ * last search is still mostly relevant to the next one in the same game, so
+ * rather than clearing it we let it fade, giving the early iterations good
+ * move ordering while letting new statistics take over quickly.
+ */
+void ageMoveHistory() {
+    int16_t *entries = &history[0][0][0];
+    for (size_t i = 0; i < sizeof(history) / sizeof(int16_t); i++)
+        entries[i] /= 2;
+
+    entries = &continuationHistory[0][0][0][0];
+    for (size_t i = 0; i < sizeof(continuationHistory) / sizeof(int16_t); i++)
+        entries[i] /= 2;
 }
 
 // Gets the history of this move
-int getMoveHistory(Board *board, Move move) {
-    // Extract move information
-    int piece = board->squares[MoveFrom(move)];
-    int to    = MoveTo(move);
+int getMoveHistory(Board *board, SearchStack *ss, Move move) {
+    PieceToHistory *continuations[2] = {
+        (ss - 1)->continuationHistory,
+        (ss - 2)->continuationHistory
+    };
+
+    return quietHistory(board, continuations, move);
+}
+
+// Applies a bonus or malus to a history entry
+static void applyHistoryDelta(int16_t *entry, int delta) {
+    // Apply delta to entry using exponential decay formula
+    int value = *entry;
+    value += delta - (value * abs(delta)) / HISTORY_MAX_VALUE;
 
-    // Return this move's history
-    return history[board->side][piece][to];
+    // Clamp history value to safe range, which also keeps it within int16_t
+    *entry = clamp(value, -HISTORY_MAX_VALUE, HISTORY_MAX_VALUE);
 }
 
-// Updates history heuristic for a move
-void updateMoveHistory(Board *board, Move move, int depth, bool malus) {
+// Updates history heuristics for a move
+void updateMoveHistory(Board *board, SearchStack *ss, Move move, int depth, bool malus) {
     // Only apply move history to quiet moves
     if (IsCapture(move)) return;
 
-    // Find history entry for this move
+    // Find history entries for this move
     int piece = board->squares[MoveFrom(move)];
     int to    = MoveTo(move);
-    int *entry = &history[board->side][piece][to];
 
     // Have negative delta if this is a malus
     int delta  = (malus) ? -depth * depth : depth * depth;
 
-    // Apply delta to entry using exponential decay formula
-    *entry += delta - (*entry * abs(delta)) / HISTORY_MAX_VALUE;
-    // printf("%d - %s\n", *entry, moveToString(move));
+    applyHistoryDelta(&history[board->side][piece][to], delta);
 
-    // Clamp history value to safe range
-    if (*entry > HISTORY_MAX_VALUE)  *entry = HISTORY_MAX_VALUE;
-    if (*entry < -HISTORY_MAX_VALUE) *entry = -HISTORY_MAX_VALUE;
+    // Continuation history for the moves one and two plies ago
+    for (int i = 1; i <= 2; i++) {
+        if ((ss - i)->continuationHistory != NULL)
+            applyHistoryDelta(&(*(ss - i)->continuationHistory)[toPiece(piece, board->side)][to], delta);
+    }
 }
 
 
 // Sets killer moves at given ply
-void updateKillers(int ply, Move move) {
+void updateKillers(SearchStack *ss, Move move) {
     // Avoid saving same killer twice
-    if (killers[0][ply] == move) return;
+    if (ss->killers[0] == move) return;
 
     // Demote old killer #1 to killer #2
-    killers[1][ply] = killers[0][ply];
-    killers[0][ply] = move;
+    ss->killers[1] = ss->killers[0];
+    ss->killers[0] = move;
+}
+
+/* -------------------------------------------------------------------------- */
+/*                          Static Exchange Evaluation                        */
+/* -------------------------------------------------------------------------- */
+
+/**
+ * Static exchange evaluation (SEE).
+ * Plays out the sequence of captures on the destination square of the move,
+ * with each side always recapturing with its least valuable attacker, and
+ * returns true if the material balance at the end is at least the threshold.
+ * X-ray attackers behind the pieces that have already captured are revealed
+ * by recalculating slider attacks with the updated occupancy.
+ * https://www.chessprogramming.org/Static_Exchange_Evaluation
+ */
+bool staticExchangeEvaluation(Board *board, Move move, int threshold) {
+    // Castling can never win or lose material.
+    if (IsCastling(move)) return threshold <= 0;
+
+    int from = MoveFrom(move);
+    int to = MoveTo(move);
+
+    // The piece which will be standing on the target square after our move.
+    int nextVictim = IsPromotion(move) ? MovePromotedPiece(move) : board->squares[from];
+
+    // Best case gain: what we capture, plus any promotion gain.
+    int balance = IsEnpass(move) ? SEE_PIECE_VALUES[PAWN] : SEE_PIECE_VALUES[board->squares[to]];
+    if (IsPromotion(move))
+        balance += SEE_PIECE_VALUES[nextVictim] - SEE_PIECE_VALUES[PAWN];
+    balance -= threshold;
+
+    // Even if the piece is never recaptured we can't reach the threshold.
+    if (balance < 0) return false;
+
+    // Worst case: we lose the piece we moved and still beat the threshold.
+    balance -= SEE_PIECE_VALUES[nextVictim];
+    if (balance >= 0) return true;
+
+    // Play the move on a local occupancy, taking the en passant pawn off too.
+    U64 occupied = (board->colors[BOTH] ^ (1ULL << from)) | (1ULL << to);
+    if (IsEnpass(move))
+        occupied ^= 1ULL << ((board->side == WHITE) ? (to - 8) : (to + 8));
+
+    U64 bishops = board->pieces[BISHOP] | board->pieces[QUEEN];
+    U64 rooks = board->pieces[ROOK] | board->pieces[QUEEN];
+    U64 attackers = allAttackersToSquare(board, occupied, to) & occupied;
+
+    // The opponent gets the first chance to recapture.
+    int color = !board->side;
+
+    while (true) {
+        U64 ourAttackers = attackers & board->colors[color];
+
+        // Side to move has no more recaptures, so they lose the exchange.
+        if (!ourAttackers) break;
+
+        // Find our least valuable attacker.
+        for (nextVictim = PAWN; nextVictim < KING; nextVictim++) {
+            if (ourAttackers & board->pieces[nextVictim])
+                break;
+        }
+
+        // Remove the attacker from the occupancy
+        occupied ^= 1ULL << getlsb(ourAttackers & board->pieces[nextVictim]);
+
+        // Reveal any x-ray attackers which were behind the piece
+        if (nextVictim == PAWN || nextVictim == BISHOP || nextVictim == QUEEN)
+            attackers |= Bmagic(to, occupied) & bishops;
+        if (nextVictim == ROOK || nextVictim == QUEEN)
+            attackers |= Rmagic(to, occupied) & rooks;
+        attackers &= occupied;
+
+        // Swap sides, and negamax the balance.
+        color = !color;
+        balance = -balance - 1 - SEE_PIECE_VALUES[nextVictim];
+
+        // The side to move can stop capturing here and stay above the threshold.
+        if (balance >= 0) {
+            // A king can't recapture into a square which is still defended.
+            if (nextVictim == KING && (attackers & board->colors[color]))
+                color = !color;
+            break;
+        }
+    }
+
+    // The side left to move at the end of the exchange is the one who lost it.
+    return board->side != color;
 }
 
 /* -------------------------------------------------------------------------- */
@@ -156,8 +282,8 @@ static int bestMoveIndex(MovePicker *picker) {
  *   - Quiet moves (Ordered via history)
  */
 
-// Initialize the move picker
-void initMovePicker(MovePicker *picker, Board *board, Move hashMove) {
+// Initialize the move picker. The search stack is NULL in quiescence search.
+void initMovePicker(MovePicker *picker, Move hashMove, SearchStack *ss) {
     if (hashMove != NO_MOVE)
         picker->stage = STAGE_HASH_MOVE;
     else
@@ -167,9 +293,11 @@ void initMovePicker(MovePicker *picker, Board *board, Move hashMove) {
     picker->currentIndex = 0;
     picker->hashMove = hashMove;
 
-    // Retrieve killers from table
-    picker->killerOne = killers[board->side][0];
-    picker->killerTwo = killers[board->side][1];
+    // Retrieve killers and continuation histories from the search stack
+    picker->killerOne = (ss != NULL) ? ss->killers[0] : NO_MOVE;
+    picker->killerTwo = (ss != NULL) ? ss->killers[1] : NO_MOVE;
+    picker->continuationHistory[0] = (ss != NULL) ? (ss - 1)->continuationHistory : NULL;
+    picker->continuationHistory[1] = (ss != NULL) ? (ss - 2)->continuationHistory : NULL;
     
     // Initialize all move scores to 0
     for (int i = 0; i < MAX_LEGAL_MOVES; i++) {
@@ -3,6 +3,7 @@
 #include "board.h"
 #include "move.h"
 #include "movegen.h"
+#include "uci.h"
 
 // Later we will add a generate noisy and quiet seperate stage
 typedef enum {
@@ -25,19 +26,26 @@ typedef struct {
     MovePickerStage stage;
     Move hashMove;
     Move killerOne, killerTwo;
+    PieceToHistory *continuationHistory[2];
     int currentIndex;
 } MovePicker;
 
+// continuationHistory[previous colored piece][previous to][colored piece][to]
+extern _Thread_local PieceToHistory continuationHistory[NB_PIECES * 2][64];
+
 // Move scoring
 void initMvvLva();
 
 void clearMoveHistory();
-void clearKillerMoves();
+void ageMoveHistory();
+
+int getMoveHistory(Board *board, SearchStack *ss, Move move);
+void updateMoveHistory(Board *board, SearchStack *ss, Move move, int depth, bool malus);
+void updateKillers(SearchStack *ss, Move move);
 
-int getMoveHistory(Board *board, Move move);
-void updateMoveHistory(Board *board, Move move, int depth, bool malus);
-void updateKillers(int ply, Move move);
+// Static exchange evaluation
+bool staticExchangeEvaluation(Board *board, Move move, int threshold);
 
 // Move picker
-void initMovePicker(MovePicker *picker, Board *board, Move hashMove);
+void initMovePicker(MovePicker *picker, Move hashMove, SearchStack *ss);
 Move pickMove(MovePicker *picker, Board *board);
@@ -0,0 +1,262 @@
+#include <assert.h>
+#include <stdio.h>
+#include <string.h>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#endif
+
+#include "nnue.h"
+#include "board.h"
+#include "bitboards.h"
+#include "search.h"
+#include "utils.h"
+
+/* -------------------------------------------------------------------------- */
+/*                                   Network                                  */
+/* -------------------------------------------------------------------------- */
+
+typedef struct {
+    _Alignas(32) int16_t featureWeights[NNUE_INPUTS][NNUE_HIDDEN];
+    _Alignas(32) int16_t featureBiases[NNUE_HIDDEN];
+    _Alignas(32) int16_t outputWeights[2 * NNUE_HIDDEN];
+    int16_t outputBias;
+} Network;
+
+// Size of the network in a file, without any padding at the end
+#define NETWORK_FILE_SIZE ((NNUE_INPUTS * NNUE_HIDDEN + NNUE_HIDDEN + 2 * NNUE_HIDDEN + 1) * sizeof(int16_t))
+
+static Network network;
+static bool networkLoaded = false;
+bool useNNUE = false;
+
+/**
+ * Networks can be embedded into the binary at compile time with
+ * `make EVALFILE=path/to/net.bin`, so the engine works without an EvalFile.
+ */
+#ifdef EVALFILE
+__asm__(
+    ".section .rodata\n"
+    ".balign 64\n"
+    ".global embeddedNetwork\n"
+    "embeddedNetwork:\n"
+    ".incbin \"" EVALFILE "\"\n"
+    ".global embeddedNetworkEnd\n"
+    "embeddedNetworkEnd:\n"
+    ".previous\n"
+);
+extern const unsigned char embeddedNetwork[];
+extern const unsigned char embeddedNetworkEnd[];
+#endif
+
+// Copies a network out of a buffer in the file format, returns false if it's too small.
+static bool readNetwork(const unsigned char *data, size_t size) {
+    if (size < NETWORK_FILE_SIZE)
+        return false;
+
+    memcpy(network.featureWeights, data, sizeof(network.featureWeights));
+    data += sizeof(network.featureWeights);
+    memcpy(network.featureBiases, data, sizeof(network.featureBiases));
+    data += sizeof(network.featureBiases);
+    memcpy(network.outputWeights, data, sizeof(network.outputWeights));
+    data += sizeof(network.outputWeights);
+    memcpy(&network.outputBias, data, sizeof(network.outputBias));
+
+    networkLoaded = true;
+    return true;
+}
+
+// Loads a network from a file, returns false (and keeps the old network) on failure.
+bool loadNetwork(const char *path) {
+    static unsigned char buffer[NETWORK_FILE_SIZE];
+
+    FILE *file = fopen(path, "rb");
+    if (file == NULL)
+        return false;
+
+    size_t size = fread(buffer, 1, NETWORK_FILE_SIZE, file);
+    fclose(file);
+
+    return readNetwork(buffer, size);
+}
+
+bool networkIsLoaded() {
+    return networkLoaded;
+}
+
+// Uses the embedded network if there is one.
+void initNNUE() {
+#ifdef EVALFILE
+    useNNUE = readNetwork(embeddedNetwork, embeddedNetworkEnd - embeddedNetwork);
+#endif
+}
+
+/* -------------------------------------------------------------------------- */
+/*                                Accumulators                                */
+/* -------------------------------------------------------------------------- */
+
+/**
+ * Input feature index of a recorded piece (colored piece * 64 + square) from a
+ * perspective. From Black's perspective the colors are swapped and the board
+ * is flipped, so that both sides see their own pieces as the first 384 inputs.
+ */
+static inline int featureIndex(int perspective, int pieceSquare) {
+    if (perspective == WHITE)
+        return pieceSquare;
+
+    int coloredPiece = pieceSquare / 64;
+    int sq = pieceSquare % 64;
+    return ((coloredPiece + NB_PIECES) % (2 * NB_PIECES)) * 64 + MIRROR_SQ(sq);
+}
+
+static inline void addFeature(int16_t *values, int feature) {
+    for (int i = 0; i < NNUE_HIDDEN; i++)
+        values[i] += network.featureWeights[feature][i];
+}
+
+static inline void removeFeature(int16_t *values, int feature) {
+    for (int i = 0; i < NNUE_HIDDEN; i++)
+        values[i] -= network.featureWeights[feature][i];
+}
+
+// Computes the accumulator of the current position from scratch.
+static void refreshAccumulator(Board *board, Accumulator *acc) {
+    for (int perspective = WHITE; perspective <= BLACK; perspective++) {
+        memcpy(acc->values[perspective], network.featureBiases, sizeof(network.featureBiases));
+
+        U64 occupied = board->colors[BOTH];
+        while (occupied) {
+            int sq = poplsb(&occupied);
+            int color = (board->colors[WHITE] & (1ULL << sq)) ? WHITE : BLACK;
+            int pieceSquare = toPiece(board->squares[sq], color) * 64 + sq;
+            addFeature(acc->values[perspective], featureIndex(perspective, pieceSquare));
+        }
+    }
+
+    acc->computed = true;
+}
+
+// Applies the recorded delta of an accumulator on top of the previous one.
+static void updateAccumulator(Accumulator *prev, Accumulator *acc) {
+    for (int perspective = WHITE; perspective <= BLACK; perspective++) {
+        int16_t *values = acc->values[perspective];
+        memcpy(values, prev->values[perspective], sizeof(acc->values[perspective]));
+
+        for (int i = 0; i < acc->addedCount; i++)
+            addFeature(values, featureIndex(perspective, acc->added[i]));
+        for (int i = 0; i < acc->removedCount; i++)
+            removeFeature(values, featureIndex(perspective, acc->removed[i]));
+    }
+
+    acc->computed = true;
+}
+
+/**
+ * Makes sure the accumulator of the current position is computed. Walks back
+ * the stack to the last computed accumulator and applies the deltas from there,
+ * or refreshes from scratch if there isn't a usable one in the ring buffer.
+ */
+static Accumulator *computeAccumulator(Board *board) {
+    int ply = board->hisPly;
+    Accumulator *acc = &board->accumulators[ply % ACCUMULATOR_STACK_SIZE];
+    if (acc->computed)
+        return acc;
+
+    // Find the last computed accumulator we can update from
+    int start = ply;
+    int oldest = MAX(0, ply - ACCUMULATOR_STACK_SIZE + 1);
+    while (true) {
+        Accumulator *entry = &board->accumulators[start % ACCUMULATOR_STACK_SIZE];
+        if (entry->needsRefresh || start == oldest) {
+            refreshAccumulator(board, acc);
+            return acc;
+        }
+
+        start--;
+        entry = &board->accumulators[start % ACCUMULATOR_STACK_SIZE];
+        if (entry->ply != start) {
+            // Overwritten by a later position after wrapping around
+            refreshAccumulator(board, acc);
+            return acc;
+        }
+        if (entry->computed)
+            break;
+    }
+
+    // Apply the deltas up to the current position
+    for (int i = start + 1; i <= ply; i++) {
+        updateAccumulator(&board->accumulators[(i - 1) % ACCUMULATOR_STACK_SIZE],
+                          &board->accumulators[i % ACCUMULATOR_STACK_SIZE]);
+    }
+
+    return acc;
+}
+
+/* -------------------------------------------------------------------------- */
+/*                                  Inference                                 */
+/* -------------------------------------------------------------------------- */
+
+/**
+ * Squared clipped ReLU of a hidden layer, dotted with its output weights.
+ *
+ * The AVX2 version computes (v * w) * v instead of (v * v) * w to stay within
+ * 16 bits before madd widens it, which is exact as long as |w| * QA fits in an
+ * int16. Output weights from bullet are clipped to +-1.98, so |w| <= 127.
+ */
+#if defined(__AVX2__)
+static int32_t screluDot(const int16_t *values, const int16_t *weights) {
+    const __m256i zero = _mm256_setzero_si256();
+    const __m256i qa = _mm256_set1_epi16(NNUE_QA);
+    __m256i sum = _mm256_setzero_si256();
+
+    for (int i = 0; i < NNUE_HIDDEN; i += 16) {
+        __m256i v = _mm256_loadu_si256((const __m256i *)(values + i));
+        __m256i w = _mm256_loadu_si256((const __m256i *)(weights + i));
+        v = _mm256_min_epi16(_mm256_max_epi16(v, zero), qa);
+        sum = _mm256_add_epi32(sum, _mm256_madd_epi16(_mm256_mullo_epi16(v, w), v));
+    }
+
+    // Horizontal sum of the 8 int32 lanes
+    __m128i sum128 = _mm_add_epi32(_mm256_castsi256_si128(sum), _mm256_extracti128_si256(sum, 1));
+    sum128 = _mm_add_epi32(sum128, _mm_shuffle_epi32(sum128, _MM_SHUFFLE(1, 0, 3, 2)));
+    sum128 = _mm_add_epi32(sum128, _mm_shuffle_epi32(sum128, _MM_SHUFFLE(2, 3, 0, 1)));
+    return _mm_cvtsi128_si32(sum128);
+}
+#else
+static int32_t screluDot(const int16_t *values, const int16_t *weights) {
+    int32_t sum = 0;
+
+    for (int i = 0; i < NNUE_HIDDEN; i++) {
+        int32_t v = values[i] < 0 ? 0 : (values[i] > NNUE_QA ? NNUE_QA : values[i]);
+        sum += v * v * weights[i];
+    }
+
+    return sum;
+}
+#endif
+
+// Evaluation of the current board state with the network, from the side to move's POV
+int evaluateNNUE(Board *board) {
+    assert(networkLoaded);
+
+    Accumulator *acc = computeAccumulator(board);
+
+#ifndef NDEBUG
+    // Check the incremental updates against a full refresh
+    Accumulator fresh;
+    refreshAccumulator(board, &fresh);
+    assert(memcmp(fresh.values, acc->values, sizeof(fresh.values)) == 0);
+#endif
+
+    int us = board->side;
+    int them = !board->side;
+
+    int32_t output = screluDot(acc->values[us], network.outputWeights)
+                   + screluDot(acc->values[them], network.outputWeights + NNUE_HIDDEN);
+
+    // Undo the quantisation, the squared activation adds an extra factor of QA
+    int eval = (output / NNUE_QA + network.outputBias) * NNUE_SCALE / (NNUE_QA * NNUE_QB);
+
+    // Keep the network away from mate scores, and within what the hash table can store
+    return MAX(-NNUE_EVAL_LIMIT, MIN(NNUE_EVAL_LIMIT, eval));
+}
@@ -0,0 +1,80 @@
+// An efficiently updatable neural network (NNUE) evaluation, as an alternative
+// to the hand crafted evaluation in eval.c.
+//
+// The architecture is the simplest one that works well: (768 -> 256)x2 -> 1.
+// The 768 inputs are one for each (color, piece, square), seen from both the
+// side to move's and the opponent's perspective, which share the same weights.
+// The two hidden layers are concatenated with the side to move first, then fed
+// through a squared clipped ReLU into a single output neuron.
+//
+// The network file is the raw little endian int16 format written by bullet
+// (https://github.com/jw1912/bullet) for this architecture:
+//   featureWeights[768][256], featureBiases[256], outputWeights[512], outputBias
+// https://www.chessprogramming.org/NNUE
+
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "board.h"
+
+#define NNUE_INPUTS 768
+
+// Quantisation of the feature transformer, the output layer and the final eval.
+#define NNUE_QA 255
+#define NNUE_QB 64
+#define NNUE_SCALE 400
+
+// Network evaluations are clamped to this
+#define NNUE_EVAL_LIMIT 30000
+
+// Whether the search should use the network instead of the HCE.
+extern bool useNNUE;
+
+/* -------------------------------------------------------------------------- */
+/*                          Accumulator delta tracking                         */
+/* -------------------------------------------------------------------------- */
+
+// Starts a new accumulator for the position after a move (or null move).
+static inline void pushAccumulator(Board *board) {
+    Accumulator *acc = &board->accumulators[board->hisPly % ACCUMULATOR_STACK_SIZE];
+    acc->ply = board->hisPly;
+    acc->computed = false;
+    acc->needsRefresh = false;
+    acc->addedCount = 0;
+    acc->removedCount = 0;
+}
+
+// Resets the accumulator stack, the current position must be refreshed.
+static inline void resetAccumulators(Board *board) {
+    pushAccumulator(board);
+    board->accumulators[board->hisPly % ACCUMULATOR_STACK_SIZE].needsRefresh = true;
+}
+
+// Records a piece being added to the current position.
+static inline void accumulatorAddPiece(Board *board, int coloredPiece, int sq) {
+    Accumulator *acc = &board->accumulators[board->hisPly % ACCUMULATOR_STACK_SIZE];
+    if (acc->addedCount < 2)
+        acc->added[acc->addedCount++] = coloredPiece * 64 + sq;
+    else
+        acc->needsRefresh = true;
+}
+
+// Records a piece being removed from the current position.
+static inline void accumulatorRemovePiece(Board *board, int coloredPiece, int sq) {
+    Accumulator *acc = &board->accumulators[board->hisPly % ACCUMULATOR_STACK_SIZE];
+    if (acc->removedCount < 2)
+        acc->removed[acc->removedCount++] = coloredPiece * 64 + sq;
+    else
+        acc->needsRefresh = true;
+}
+
+/* -------------------------------------------------------------------------- */
+/*                              Public functions                              */
+/* -------------------------------------------------------------------------- */
+
+void initNNUE();
+bool loadNetwork(const char *path);
+bool networkIsLoaded();
+int evaluateNNUE(Board *board);
@@ -0,0 +1,69 @@
+#include <assert.h>
+#include <string.h>
+
+#include "packed.h"
+#include "board.h"
+#include "bitboards.h"
+#include "zobrist.h"
+
+// Castling right of a rook on its starting square, if it has one
+static int castleRight(int sq) {
+    switch (sq) {
+    case H1: return CASTLE_WK;
+    case A1: return CASTLE_WQ;
+    case H8: return CASTLE_BK;
+    case A8: return CASTLE_BQ;
+    default: return 0;
+    }
+}
+
+// Packs a board with its score and the game result, see packed.h.
+void packBoard(Board *board, int score, int result, PackedBoard *packed) {
+    memset(packed, 0, sizeof(PackedBoard));
+    packed->occupancy = board->colors[BOTH];
+
+    U64 occupied = board->colors[BOTH];
+    for (int i = 0; occupied; i++) {
+        int sq = poplsb(&occupied);
+        int color = (board->colors[WHITE] >> sq) & 1 ? WHITE : BLACK;
+        int piece = board->squares[sq] % NB_PIECES;
+
+        if (piece == ROOK && (board->castlePerm & castleRight(sq)))
+            piece = PACKED_CASTLE_ROOK;
+
+        packed->pieces[i / 2] |= (piece | color << 3) << (4 * (i % 2));
+    }
+
+    int epSquare = (board->epSquare == NO_SQ) ? PACKED_NO_SQ : board->epSquare;
+    packed->sideEp = (board->side << 7) | epSquare;
+    packed->fiftyMove = board->fiftyMove;
+    packed->fullMove = 1 + board->hisPly / 2;
+    packed->score = score;
+    packed->result = result;
+}
+
+// Sets up a board from a packed position, like parseFen does for a FEN.
+void unpackBoard(const PackedBoard *packed, Board *board) {
+    clearBoard(board);
+
+    U64 occupied = packed->occupancy;
+    for (int i = 0; occupied; i++) {
+        int sq = poplsb(&occupied);
+        int code = (packed->pieces[i / 2] >> (4 * (i % 2))) & 15;
+        int color = code >> 3;
+        int piece = code & 7;
+
+        if (piece == PACKED_CASTLE_ROOK) {
+            piece = ROOK;
+            board->castlePerm |= castleRight(sq);
+        }
+
+        setPiece(board, color, piece, sq);
+    }
+
+    int epSquare = packed->sideEp & 127;
+    board->side = packed->sideEp >> 7;
+    board->epSquare = (epSquare == PACKED_NO_SQ) ? NO_SQ : epSquare;
+    board->fiftyMove = packed->fiftyMove;
+    board->hash = generateHash(board);
+}
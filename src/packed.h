@@ -0,0 +1,45 @@
+// Compact fixed size position format for training data.
+//
+// A position with its score and game result packs into 32 bytes, instead of a
+// ~60 byte FEN which has to be parsed character by character. The layout is
+// the same as marlinformat (https://github.com/jnlt3/marlinflow), so existing
+// tools can read our data:
+//
+//   occupancy    bitboard of every occupied square
+//   pieces       4 bits per occupied square, in the order of the occupancy bits:
+//                the piece (or PACKED_CASTLE_ROOK for rooks which can still
+//                castle), with the color in the top bit
+//   sideEp       side to move in the top bit, en passant square (or 64) below
+//   fiftyMove    fifty move counter
+//   fullMove     move number, from the number of plies played on the board
+//   score        search score from White's POV
+//   result       game result from White's POV, 0 for a loss, 1 draw, 2 win
+
+#pragma once
+
+#include <stdint.h>
+
+#include "board.h"
+
+// Piece code of a rook with castling rights
+#define PACKED_CASTLE_ROOK 6
+
+#define PACKED_NO_SQ 64
+
+enum { PACKED_LOSS, PACKED_DRAW, PACKED_WIN };
+
+typedef struct {
+    uint64_t occupancy;
+    uint8_t pieces[16];
+    uint8_t sideEp;
+    uint8_t fiftyMove;
+    uint16_t fullMove;
+    int16_t score;
+    uint8_t result;
+    uint8_t unused;
+} PackedBoard;
+
+_Static_assert(sizeof(PackedBoard) == 32, "PackedBoard should be 32 bytes");
+
+void packBoard(Board *board, int score, int result, PackedBoard *packed);
+void unpackBoard(const PackedBoard *packed, Board *board);
@@ -0,0 +1,477 @@
+#include <ctype.h>
+#include <inttypes.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "pgn.h"
+#include "board.h"
+#include "chain.h"
+#include "makemove.h"
+#include "movegen.h"
+#include "packed.h"
+#include "uci.h"
+#include "utils.h"
+
+// Longest tag value we keep, e.g. a FEN
+#define PGN_TAG_SIZE 256
+
+// Output buffered by each thread before it's written to the file
+#define PGN_FLUSH_SIZE (1 << 20)
+
+/* -------------------------------------------------------------------------- */
+/*                                     SAN                                    */
+/* -------------------------------------------------------------------------- */
+
+static int pieceFromChar(char c) {
+    switch (c) {
+    case 'N': return KNIGHT;
+    case 'B': return BISHOP;
+    case 'R': return ROOK;
+    case 'Q': return QUEEN;
+    case 'K': return KING;
+    default: return NO_PIECE;
+    }
+}
+
+static bool isFile(char c) { return c >= 'a' && c <= 'h'; }
+static bool isRank(char c) { return c >= '1' && c <= '8'; }
+
+/**
+ * Finds the legal move a SAN move (e.g. Nbd7, exd8=Q+, O-O) stands for, or
+ * NO_MOVE if there isn't one. Check and annotation symbols are ignored.
+ */
+Move parseSan(Board *board, const char *san, int length) {
+    while (length > 0 && strchr("+#!?", san[length - 1]))
+        length--;
+
+    if (length < 2)
+        return NO_MOVE;
+
+    // Castling is written as O-O, or with zeros by some programs
+    bool kingSide = (length == 3 && (!strncmp(san, "O-O", 3) || !strncmp(san, "0-0", 3)));
+    bool queenSide = (length == 5 && (!strncmp(san, "O-O-O", 5) || !strncmp(san, "0-0-0", 5)));
+
+    int piece = PAWN;
+    int promoted = NO_PIECE;
+    int fromFile = -1, fromRank = -1;
+    int to = NO_SQ;
+
+    if (!kingSide && !queenSide) {
+        int start = 0;
+        if (pieceFromChar(san[0]) != NO_PIECE) {
+            piece = pieceFromChar(san[0]);
+            start = 1;
+        }
+
+        // Promotions are e8=Q, or e8Q without the =
+        if (piece == PAWN && pieceFromChar(san[length - 1]) != NO_PIECE) {
+            promoted = pieceFromChar(san[length - 1]);
+            length -= (san[length - 2] == '=') ? 2 : 1;
+        }
+
+        if (length - start < 2 || !isFile(san[length - 2]) || !isRank(san[length - 1]))
+            return NO_MOVE;
+        to = squareFrom(san[length - 2] - 'a', san[length - 1] - '1');
+
+        // Whatever is left before the destination disambiguates the piece
+        for (int i = start; i < length - 2; i++) {
+            if (isFile(san[i]))
+                fromFile = san[i] - 'a';
+            else if (isRank(san[i]))
+                fromRank = san[i] - '1';
+            else if (san[i] != 'x')
+                return NO_MOVE;
+        }
+    }
+
+    MoveList moves;
+    generatePseudoLegalMoves(&moves, board);
+
+    for (int i = 0; i < moves.count; i++) {
+        Move move = moves.list[i];
+        int from = MoveFrom(move);
+
+        if (kingSide || queenSide) {
+            if (!IsCastling(move) || fileOf(MoveTo(move)) != (kingSide ? 6 : 2))
+                continue;
+        } else {
+            if (IsCastling(move) || MoveTo(move) != to || board->squares[from] != piece)
+                continue;
+            if ((fromFile >= 0 && fileOf(from) != fromFile) || (fromRank >= 0 && rankOf(from) != fromRank))
+                continue;
+            if (IsPromotion(move) ? MovePromotedPiece(move) != promoted : promoted != NO_PIECE)
+                continue;
+        }
+
+        int legal = makeMove(board, move);
+        undoMove(board, move);
+        if (legal)
+            return move;
+    }
+
+    return NO_MOVE;
+}
+
+/* -------------------------------------------------------------------------- */
+/*                                   Parsing                                  */
+/* -------------------------------------------------------------------------- */
+
+typedef struct {
+    const char *data;
+    const char *end;
+    PgnGameCallback callback;
+    void *context;
+    size_t games;
+    size_t errors;
+} PgnChunk;
+
+static const char *skipSpaces(const char *p, const char *end) {
+    while (p < end && isspace((unsigned char) *p))
+        p++;
+    return p;
+}
+
+static const char *skipLine(const char *p, const char *end) {
+    const char *newline = memchr(p, '\n', end - p);
+    return newline ? newline + 1 : end;
+}
+
+static const char *skipComment(const char *p, const char *end) {
+    const char *close = memchr(p, '}', end - p);
+    return close ? close + 1 : end;
+}
+
+// Skips a variation, which can have comments and variations of its own
+static const char *skipVariation(const char *p, const char *end) {
+    int depth = 0;
+    while (p < end) {
+        if (*p == '{') {
+            p = skipComment(p + 1, end);
+            continue;
+        }
+
+        if (*p == '(')
+            depth++;
+        else if (*p == ')' && depth-- == 0)
+            return p + 1;
+        p++;
+    }
+    return end;
+}
+
+static bool startsWith(const char *token, const char *tokenEnd, const char *prefix) {
+    size_t length = strlen(prefix);
+    return (size_t) (tokenEnd - token) >= length && !strncmp(token, prefix, length);
+}
+
+// Reads a tag line like [Result "1-0"], returns the line after it
+static const char *readTag(const char *p, const char *end, char *name, char *value) {
+    const char *lineEnd = memchr(p, '\n', end - p);
+    if (lineEnd == NULL)
+        lineEnd = end;
+
+    name[0] = value[0] = '\0';
+    const char *nameEnd = p + 1;
+    while (nameEnd < lineEnd && !isspace((unsigned char) *nameEnd))
+        nameEnd++;
+
+    const char *quote = memchr(nameEnd, '"', lineEnd - nameEnd);
+    const char *closing = quote ? memchr(quote + 1, '"', lineEnd - quote - 1) : NULL;
+    if (closing) {
+        int nameLength = MIN(nameEnd - p - 1, PGN_TAG_SIZE - 1);
+        int valueLength = MIN(closing - quote - 1, PGN_TAG_SIZE - 1);
+        memcpy(name, p + 1, nameLength);
+        memcpy(value, quote + 1, valueLength);
+        name[nameLength] = '\0';
+        value[valueLength] = '\0';
+    }
+
+    return skipLine(p, end);
+}
+
+/**
+ * Parses the game starting at p, and calls back with it if it has a result
+ * and all its moves could be parsed. Returns where the next game starts.
+ */
+static const char *readGame(PgnChunk *chunk, const char *p, Board *board, Move *moves) {
+    char name[PGN_TAG_SIZE], value[PGN_TAG_SIZE];
+    char fen[PGN_TAG_SIZE] = START_FEN;
+    int result = -1;
+
+    // Tag section
+    for (p = skipSpaces(p, chunk->end); p < chunk->end && *p == '['; p = skipSpaces(p, chunk->end)) {
+        p = readTag(p, chunk->end, name, value);
+
+        if (!strcmp(name, "FEN"))
+            strcpy(fen, value);
+        else if (!strcmp(name, "Result"))
+            result = !strcmp(value, "1-0") ? PACKED_WIN
+                   : !strcmp(value, "0-1") ? PACKED_LOSS
+                   : !strcmp(value, "1/2-1/2") ? PACKED_DRAW : -1;
+    }
+
+    parseFen(board, fen);
+    int count = 0;
+    bool error = false;
+
+    // Movetext, up to the next tag section
+    while (p < chunk->end) {
+        p = skipSpaces(p, chunk->end);
+        if (p >= chunk->end || (*p == '[' && (p == chunk->data || p[-1] == '\n')))
+            break;
+
+        if (*p == '{') {
+            p = skipComment(p + 1, chunk->end);
+        } else if (*p == '(') {
+            p = skipVariation(p + 1, chunk->end);
+        } else if (*p == ';' || *p == '%') {
+            p = skipLine(p, chunk->end);
+        } else {
+            const char *token = p;
+            while (p < chunk->end && !isspace((unsigned char) *p) && !strchr("{}();", *p))
+                p++;
+
+            // Game termination markers
+            if (startsWith(token, p, "1-0") || startsWith(token, p, "0-1")
+                || startsWith(token, p, "1/2-1/2") || *token == '*')
+                continue;
+
+            // Move numbers (12. or 12...) can be stuck to the move, but castling can be written as 0-0
+            if (!startsWith(token, p, "0-0")) {
+                while (token < p && (isdigit((unsigned char) *token) || *token == '.'))
+                    token++;
+            }
+
+            // NAGs and the move numbers themselves
+            if (token == p || *token == '$')
+                continue;
+
+            if (error || count >= MAX_MOVES - 1)
+                continue;
+
+            Move move = parseSan(board, token, p - token);
+            if (move == NO_MOVE) {
+                error = true;
+                continue;
+            }
+
+            moves[count++] = move;
+            makeMove(board, move);
+        }
+    }
+
+    if (error) {
+        chunk->errors++;
+    } else if (result >= 0 && count > 0) {
+        // Hand over the game from its start position
+        for (int i = count - 1; i >= 0; i--)
+            undoMove(board, moves[i]);
+
+        chunk->callback(chunk->context, board, moves, count, result);
+        chunk->games++;
+    }
+
+    return p;
+}
+
+static void *readChunk(void *arg) {
+    PgnChunk *chunk = arg;
+    Board *board = malloc(sizeof(Board));
+    Move *moves = malloc(MAX_MOVES * sizeof(Move));
+
+    const char *p = chunk->data;
+    while ((p = skipSpaces(p, chunk->end)) < chunk->end) {
+        const char *next = readGame(chunk, p, board, moves);
+
+        // Skip anything which isn't a game
+        p = (next == p) ? skipLine(p, chunk->end) : next;
+    }
+
+    free(moves);
+    free(board);
+    return NULL;
+}
+
+/**
+ * Finds the first game which starts at or after p: a tag line which doesn't
+ * follow another tag line.
+ */
+static const char *nextGameStart(const char *data, const char *p, const char *end) {
+    for (; p < end; p = skipLine(p, end)) {
+        if (*p != '[' || (p > data && p[-1] != '\n'))
+            continue;
+
+        const char *previous = p - 1;
+        while (previous > data && isspace((unsigned char) *previous))
+            previous--;
+
+        if (previous <= data || *previous != ']')
+            return p;
+    }
+    return end;
+}
+
+/**
+ * Parses every game of a PGN on a number of threads. Each thread calls back
+ * with its own context, so nothing has to be shared while parsing.
+ */
+void readPgn(const char *data, size_t size, int threads, PgnGameCallback callback, void **contexts, size_t *games, size_t *errors) {
+    const char *end = data + size;
+    pthread_t *handles = malloc(threads * sizeof(pthread_t));
+    PgnChunk *chunks = malloc(threads * sizeof(PgnChunk));
+
+    // Split the file evenly, then move each split forward to the start of a game
+    const char *start = data;
+    for (int i = 0; i < threads; i++) {
+        const char *split = (i == threads - 1) ? end : data + size * (i + 1) / threads;
+        if (split < end)
+            split = nextGameStart(data, MAX(split, start), end);
+
+        chunks[i] = (PgnChunk) { .data = start, .end = split, .callback = callback, .context = contexts[i] };
+        pthread_create(&handles[i], NULL, readChunk, &chunks[i]);
+        start = split;
+    }
+
+    *games = *errors = 0;
+    for (int i = 0; i < threads; i++) {
+        pthread_join(handles[i], NULL);
+        *games += chunks[i].games;
+        *errors += chunks[i].errors;
+    }
+
+    free(handles);
+    free(chunks);
+}
+
+/* -------------------------------------------------------------------------- */
+/*                                 Conversion                                 */
+/* -------------------------------------------------------------------------- */
+
+enum { PGN_TO_FEN, PGN_TO_PACKED, PGN_TO_CHAIN };
+
+typedef struct {
+    FILE *file;
+    pthread_mutex_t lock;
+    int format;
+    size_t positions;
+} PgnOutput;
+
+// Output of one thread, written to the file once in a while
+typedef struct {
+    PgnOutput *output;
+    char *buffer;
+    size_t size, capacity;
+    size_t positions;
+    ChainGame *chain;
+} PgnWriter;
+
+static void *reserve(PgnWriter *writer, size_t bytes) {
+    if (writer->size + bytes > writer->capacity) {
+        writer->capacity = MAX(writer->capacity * 2, writer->size + bytes);
+        writer->buffer = realloc(writer->buffer, writer->capacity);
+    }
+
+    void *space = writer->buffer + writer->size;
+    writer->size += bytes;
+    return space;
+}
+
+static void flushWriter(PgnWriter *writer) {
+    pthread_mutex_lock(&writer->output->lock);
+    fwrite(writer->buffer, 1, writer->size, writer->output->file);
+    writer->output->positions += writer->positions;
+    pthread_mutex_unlock(&writer->output->lock);
+
+    writer->size = 0;
+    writer->positions = 0;
+}
+
+static void writeGame(void *context, Board *board, const Move *moves, int count, int result) {
+    PgnWriter *writer = context;
+    static const char *RESULTS[] = { "[0.0]", "[0.5]", "[1.0]" };
+
+    if (writer->output->format == PGN_TO_CHAIN) {
+        chainBegin(writer->chain, board);
+        for (int i = 0; i < count; i++)
+            chainAddMove(writer->chain, moves[i], 0);
+        chainFinish(writer->chain, result);
+
+        size_t bytes = CHAIN_HEADER_SIZE + writer->chain->size;
+        memcpy(reserve(writer, bytes), writer->chain, bytes);
+        writer->positions += writer->chain->positions;
+    } else {
+        for (int i = 0; i < count; i++) {
+            if (writer->output->format == PGN_TO_PACKED) {
+                packBoard(board, 0, result, reserve(writer, sizeof(PackedBoard)));
+            } else {
+                char line[FEN_BUFFER_SIZE + 16];
+                boardToFen(board, line);
+                int length = strlen(line);
+                length += sprintf(line + length, " %s\n", RESULTS[result]);
+                memcpy(reserve(writer, length), line, length);
+            }
+
+            makeMove(board, moves[i]);
+        }
+        writer->positions += count;
+    }
+
+    if (writer->size >= PGN_FLUSH_SIZE)
+        flushWriter(writer);
+}
+
+// Converts every game of a PGN into positions, see pgn.h.
+void convertPgn(const char *input, const char *output, int threads) {
+    size_t size;
+    const char *data = mapFile(input, &size);
+    if (data == NULL) {
+        printf("Could not open %s\n", input);
+        return;
+    }
+
+    PgnOutput out = {0};
+    out.format = hasExtension(output, ".bin") ? PGN_TO_PACKED
+               : hasExtension(output, ".chain") ? PGN_TO_CHAIN : PGN_TO_FEN;
+    out.file = fopen(output, "wb");
+    if (out.file == NULL) {
+        printf("Could not open %s\n", output);
+        unmapFile(data, size);
+        return;
+    }
+
+    if (threads <= 0)
+        threads = cpuCount();
+
+    pthread_mutex_init(&out.lock, NULL);
+    PgnWriter *writers = calloc(threads, sizeof(PgnWriter));
+    void **contexts = malloc(threads * sizeof(void *));
+    for (int i = 0; i < threads; i++) {
+        writers[i].output = &out;
+        writers[i].chain = (out.format == PGN_TO_CHAIN) ? malloc(sizeof(ChainGame)) : NULL;
+        contexts[i] = &writers[i];
+    }
+
+    int start = getTime();
+    size_t games, errors;
+    readPgn(data, size, threads, writeGame, contexts, &games, &errors);
+
+    for (int i = 0; i < threads; i++) {
+        flushWriter(&writers[i]);
+        free(writers[i].buffer);
+        free(writers[i].chain);
+    }
+
+    int elapsed = MAX(getTime() - start, 1);
+    printf("Read %zu games (%zu positions) with %d threads in %d ms, %.0f games/s, %.1f MB/s\n",
+           games, out.positions, threads, elapsed, games * 1000.0 / elapsed, size / 1000.0 / elapsed);
+    if (errors)
+        printf("Skipped %zu games with moves which couldn't be parsed\n", errors);
+
+    free(writers);
+    free(contexts);
+    pthread_mutex_destroy(&out.lock);
+    fclose(out.file);
+    unmapFile(data, size);
+}
@@ -0,0 +1,32 @@
+// PGN ingestion, for turning game archives into training data or books.
+//
+// The PGN file is memory mapped and split into one chunk per thread, at the
+// start of a game's tag section, so every thread parses whole games on its
+// own. Moves are parsed from SAN by matching them against the moves of the
+// move generator. Every position before each move of every game with a result
+// is written out, with the result of the game:
+//
+//   .bin         packed positions, see packed.h (with a score of 0)
+//   .chain       chained games, see chain.h (with a score of 0)
+//   otherwise    "<fen> [result]" lines, which the tuner reads
+//
+// Games with a FEN tag start from that position. Variations, comments and
+// NAGs are skipped, and games with an unknown result ("*") or a move which
+// can't be parsed are left out.
+//
+// Usage: pgn <input.pgn> <output> [threads]
+
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "board.h"
+#include "move.h"
+
+// Called for every game with a result, with the board at the start of the game
+typedef void (*PgnGameCallback)(void *context, Board *board, const Move *moves, int count, int result);
+
+Move parseSan(Board *board, const char *san, int length);
+void readPgn(const char *data, size_t size, int threads, PgnGameCallback callback, void **contexts, size_t *games, size_t *errors);
+void convertPgn(const char *input, const char *output, int threads);
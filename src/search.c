@@ -15,15 +15,20 @@
 #include "hashtable.h"
 #include "uci.h"
 #include "utils.h"
+#include "bitbase.h"
 
 /* -------------------------------------------------------------------------- */
 /*                               Search Helpers                               */
 /* -------------------------------------------------------------------------- */
 
-// Late move reduction table.
-// int reduction = LMR_TABLE[depth][movesPlayed];
-int LMR_TABLE[MAX_DEPTH][MAX_LEGAL_MOVES];
-int LMP_TABLE[LMP_DEPTH + 1];
+// Late move reduction table, for captures (0) and quiets (1).
+// int reduction = LMR_TABLE[isQuiet][depth][movesPlayed];
+int LMR_TABLE[2][MAX_DEPTH][MAX_LEGAL_MOVES];
+int LMP_TABLE[2][LMP_DEPTH + 1];
+
+// Root search driver and threads, set by UCI options
+SearchMode searchMode = SEARCH_MODE_ALPHA_BETA;
+int searchThreads = 1;
 
 void initSearchTables() {
     // Set all values to zero by default
@@ -33,22 +38,25 @@ void initSearchTables() {
     // Initialises the Late Move Reduction Table
     for (int depth = 1; depth < MAX_DEPTH; depth++) {
         for (int movesPlayed = 1; movesPlayed < MAX_LEGAL_MOVES; movesPlayed++) {
-            // Eyeballed formula
-            int reduction = LMR_BASE_REDUCTION + log(MIN(depth, 64)) * log(MIN(movesPlayed, 64)) / LMR_DIVISOR;
-            if (reduction < 0)
-                reduction = 0;
-                
-            LMR_TABLE[depth][movesPlayed] = reduction;
+            double logProduct = log(MIN(depth, 64)) * log(MIN(movesPlayed, 64));
+
+            // Eyeballed formulas, captures are reduced less than quiets
+            int captureReduction = LMR_CAPTURE_BASE_REDUCTION + logProduct / LMR_CAPTURE_DIVISOR;
+            int quietReduction = LMR_BASE_REDUCTION + logProduct / LMR_DIVISOR;
+
+            LMR_TABLE[0][depth][movesPlayed] = MAX(captureReduction, 0);
+            LMR_TABLE[1][depth][movesPlayed] = MAX(quietReduction, 0);
 
             // if (depth <= 14 && movesPlayed <= 35)
             //     printf("D: %d Move: %d R: %d\n", depth, movesPlayed, reduction);
         }
     }
 
-    // Initialises the Late Pruning Table
+    // Initialises the Late Pruning Table, [improving][depth]
     for (int depth = 1; depth <= LMP_DEPTH; depth++) {
-        LMP_TABLE[depth] = LMP_BASE + LMP_PRODUCT * depth * depth;
-        // printf("%d\n", LMP_TABLE[depth]);
+        LMP_TABLE[0][depth] = (LMP_BASE + LMP_PRODUCT * depth * depth) / 2;
+        LMP_TABLE[1][depth] = LMP_BASE + LMP_PRODUCT * depth * depth;
+        // printf("%d %d\n", LMP_TABLE[0][depth], LMP_TABLE[1][depth]);
     }
 }
 
@@ -68,12 +76,12 @@ int drawScore(U64 nodes) {
 }
 
 // Check if search is over, or user typed stop
-static int checkSearchOver(Engine *engine) {
+int checkSearchOver(Engine *engine) {
     SearchLimits *limits = &engine->limits;
 
     if (limits->searchType == LIMIT_INFINITE) {
         // In infinite search, only user stop can end it.
-        if (checkUserStop()) {
+        if (engine->pollInput && checkUserStop()) {
             engine->searchState = SEARCH_STOPPED;
             return true;
         } else {
@@ -95,7 +103,7 @@ static int checkSearchOver(Engine *engine) {
         }
     }
 
-    if (checkUserStop()) {
+    if (engine->pollInput && checkUserStop()) {
         engine->searchState = SEARCH_STOPPED;
         return true;
     } else {
@@ -151,34 +159,27 @@ static int quiesce(Engine *engine, int alpha, int beta, int ply) {
      * https://talkchess.com/viewtopic.php?t=47373
      */
     Move hashMove = NO_MOVE;
-    int hashDepth, hashScore, hashFlag;
-    if (!pvNode) {
-        if (hashTableProbe(
-            board->hash,
-            ply,
-            &hashMove,
-            &hashDepth,
-            &hashScore,
-            &hashFlag
-        ) == PROBE_SUCCESS) {
-            /**
-             * We return immediately if the table has an exact score, or a
-             * score that produces a cutoff with our lower/upper bound.
-             */
-            if (hashFlag == BOUND_EXACT ||
-                (hashFlag == BOUND_LOWER && hashScore >= beta) ||
-                (hashFlag == BOUND_UPPER && hashScore <= alpha)) {
-                return hashScore;
-            }
+    int hashDepth, hashScore, hashEval, hashFlag;
+    bool hashHit = hashTableProbe(board->hash, ply, &hashMove, &hashDepth, &hashScore, &hashEval, &hashFlag) == PROBE_SUCCESS;
+    if (hashHit && !pvNode) {
+        /**
+         * We return immediately if the table has an exact score, or a
+         * score that produces a cutoff with our lower/upper bound.
+         */
+        if (hashFlag == BOUND_EXACT ||
+            (hashFlag == BOUND_LOWER && hashScore >= beta) ||
+            (hashFlag == BOUND_UPPER && hashScore <= alpha)) {
+            return hashScore;
         }
     }
     
     /*
      * During quiescence, we are not "forced" to move, i.e. we have the choice to
      * not move at all, accepting the current evaluation. This is the "stand pat"
-     * score (taken from poker).
+     * score (taken from poker). The hash table saves us evaluating it again,
+     * otherwise a lazy eval is enough when we're far above beta.
      */
-    int standPat = evaluate(board);
+    int standPat = (hashHit && hashEval != EVAL_NONE) ? hashEval : evaluateLazy(board, beta);
     
     // Evaluation pruning. If the evaluation already beats beta, we can stop now.
     if (standPat >= beta)
@@ -196,7 +197,7 @@ static int quiesce(Engine *engine, int alpha, int beta, int ply) {
     MovePicker picker;
 
     // Don't use hash move because it's usually not helpful in qsearch (i think)
-    initMovePicker(&picker, board, NO_MOVE);
+    initMovePicker(&picker, NO_MOVE, NULL);
 
     Move move;
     while ((move = pickMove(&picker, board)) != NO_MOVE) {
@@ -259,7 +260,7 @@ static int quiesce(Engine *engine, int alpha, int beta, int ply) {
      * We store with depth zero so the score is not trusted for cutoffs in the
      * main search tree.
      */
-    hashTableStore(board->hash, ply, bestMove, 0, bestScore, hashBound);
+    hashTableStore(board->hash, ply, bestMove, 0, bestScore, standPat, hashBound);
 
     // Propogate the best score we found up the tree.
     return bestScore;
@@ -270,17 +271,20 @@ static int quiesce(Engine *engine, int alpha, int beta, int ply) {
 /* -------------------------------------------------------------------------- */
 
 // Principal variation search, with fail-soft alpha beta.
-static int search(Engine *engine, PV *pv, int alpha, int beta, int depth, int ply, bool cutNode) {
+static int search(Engine *engine, int alpha, int beta, int depth, int ply, bool cutNode) {
     if (engine->searchState == SEARCH_STOPPED) return SEARCH_STOPPED_SCORE;
 
     // Initialise this node's information.
     Board *board = &engine->board;
-    PV childPV;
+    SearchStack *ss = &engine->searchStack[ply + SEARCH_STACK_OFFSET];
+    PV *pv = &ss->pv;
+    PV *childPV = &(ss + 1)->pv;
     pv->length = 0;
 
-    // Classify the node type
+    // Classify the node type. The root is always a PV node, even when it's
+    // searched with a null window (MTD(f)), so it's never pruned without a move.
     const int rootNode = (ply == 0);
-    const int pvNode = (alpha != beta - 1);
+    const int pvNode = rootNode || (alpha != beta - 1);
 
     /**
      * When we reach the edge of our search depth, we switch to quiescence search
@@ -329,6 +333,22 @@ static int search(Engine *engine, PV *pv, int alpha, int beta, int depth, int pl
         beta = MIN(beta, MATE_SCORE - ply - 1);
 
         if (alpha >= beta) return alpha;
+
+        /**
+         * Endgame bitbases know the exact result of positions with few pieces.
+         * They don't know how far the win is, so they're only probed right
+         * after a capture or pawn move, where the search converts into them,
+         * and the evaluation is added on top to prefer the easier wins.
+         */
+        if (board->fiftyMove == 0 && popCount(board->colors[BOTH]) <= bitbasePieces) {
+            int result = probeBitbase(board);
+            if (result == BITBASE_DRAW)
+                return drawScore(engine->searchStats.nodes);
+            if (result == BITBASE_WIN)
+                return BITBASE_WIN_SCORE + evaluate(board);
+            if (result == BITBASE_LOSS)
+                return -BITBASE_WIN_SCORE + evaluate(board);
+        }
     }
 
     /**
@@ -340,8 +360,9 @@ static int search(Engine *engine, PV *pv, int alpha, int beta, int depth, int pl
      * https://www.chessprogramming.org/Transposition_Table
      */
     Move hashMove = NO_MOVE;
-    int hashDepth, hashScore, hashFlag;
-    if (hashTableProbe(board->hash, ply, &hashMove, &hashDepth, &hashScore, &hashFlag) == PROBE_SUCCESS) {
+    int hashDepth, hashScore, hashEval, hashFlag;
+    bool hashHit = hashTableProbe(board->hash, ply, &hashMove, &hashDepth, &hashScore, &hashEval, &hashFlag) == PROBE_SUCCESS;
+    if (hashHit) {
         /**
          * Do not cutoff at root node since we need a best move. We still grab
          * hash move on root node to speed up move ordering though.
@@ -367,8 +388,26 @@ static int search(Engine *engine, PV *pv, int alpha, int beta, int depth, int pl
     }
 
     // Calculate eval and whether we're in check for use later.
+    // The static evaluation is meaningless while in check, so we skip it.
+    // If the hash table has a static eval for this position we reuse it.
     bool inCheck = boardIsInCheck(board);
-    int eval = evaluate(board);
+    if (inCheck)
+        ss->staticEval = EVAL_NONE;
+    else if (hashHit && hashEval != EVAL_NONE)
+        ss->staticEval = hashEval;
+    else
+        ss->staticEval = evaluate(board);
+    int eval = ss->staticEval;
+
+    /**
+     * Improving heuristic.
+     * If our static evaluation is better than it was on our previous turn, the
+     * position is likely getting better for us and fail highs are more likely,
+     * so we prune more aggressively. Otherwise, we prune and reduce less.
+     * https://www.chessprogramming.org/Improving
+     */
+    bool improving = !inCheck
+        && ((ss - 2)->staticEval == EVAL_NONE || ss->staticEval > (ss - 2)->staticEval);
 
     /**
      * Check extension.
@@ -392,12 +431,31 @@ static int search(Engine *engine, PV *pv, int alpha, int beta, int depth, int pl
         && !inCheck
         && depth <= REVERSE_FUTILITY_DEPTH
     ) {
-        int score = eval - REVERSE_FUTILITY_MARGIN * depth;
+        int score = eval - REVERSE_FUTILITY_MARGIN * (depth - improving);
         if (score >= beta) {
             return score;
         }
     }
 
+    /**
+     * Razoring.
+     * If the static evaluation is so far below alpha that even a few quiet
+     * moves are unlikely to recover, we drop straight into quiescence search
+     * to check whether a tactic can save us. If it can't, we trust the fail low.
+     * https://www.chessprogramming.org/Razoring
+     */
+    if (
+        !pvNode
+        && !inCheck
+        && depth <= RAZOR_DEPTH
+        && eval + RAZOR_MARGIN * depth <= alpha
+    ) {
+        int score = quiesce(engine, alpha, alpha + 1, ply);
+        if (score <= alpha) {
+            return score;
+        }
+    }
+
     /**
      * Null move pruning.
      * If our position is so strong that giving our opponent two moves in a row
@@ -419,8 +477,10 @@ static int search(Engine *engine, PV *pv, int alpha, int beta, int depth, int pl
         nullDepth = MAX(nullDepth, 0);
 
         // Make the null move.
+        ss->move = NO_MOVE;
+        ss->continuationHistory = NULL;
         makeNullMove(board);
-        int score = -search(engine, &childPV, -beta, -beta + 1, nullDepth, ply + 1, !cutNode);
+        int score = -search(engine, -beta, -beta + 1, nullDepth, ply + 1, !cutNode);
         undoNullMove(board);
 
         // If we are still above beta then we prune this branch.
@@ -429,6 +489,65 @@ static int search(Engine *engine, PV *pv, int alpha, int beta, int depth, int pl
         }
     }
 
+    /**
+     * ProbCut.
+     * If a good capture beats beta by a big margin in a reduced depth search,
+     * then a full depth search would very likely fail high too, so we can prune
+     * this node. The captures are first verified with a cheap quiescence search
+     * so that we only spend a reduced search on the promising ones. This catches
+     * tactical positions where null move pruning can't cut, e.g. because the
+     * static evaluation is below beta until the capture is made.
+     * https://www.chessprogramming.org/ProbCut
+     */
+    int probcutBeta = beta + PROBCUT_MARGIN;
+    if (
+        !pvNode
+        && !inCheck
+        && depth >= PROBCUT_DEPTH
+        && !isMateScore(beta)
+        // Skip if the hash table already tells us the capture search will fail
+        && !(hashHit && hashDepth >= depth - PROBCUT_REDUCTION + 1 && hashScore < probcutBeta)
+    ) {
+        int probcutDepth = depth - PROBCUT_REDUCTION;
+
+        // Only try the hash move if it's a capture, since we only want captures.
+        MovePicker picker;
+        initMovePicker(&picker, IsCapture(hashMove) ? hashMove : NO_MOVE, ss);
+
+        Move move;
+        while ((move = pickMove(&picker, board)) != NO_MOVE) {
+            // No captures exist after the first quiet in my ordering.
+            if (!IsCapture(move)) break;
+
+            // Skip captures which can't possibly win enough material.
+            if (!staticExchangeEvaluation(board, move, probcutBeta - eval))
+                continue;
+
+            // Skip illegal moves
+            int movedPiece = board->squares[MoveFrom(move)];
+            if (makeMove(board, move) == 0) {
+                undoMove(board, move);
+                continue;
+            }
+            ss->move = move;
+            ss->continuationHistory = &continuationHistory[toPiece(movedPiece, !board->side)][MoveTo(move)];
+
+            // Verify with quiescence search first, then a reduced depth search.
+            int score = -quiesce(engine, -probcutBeta, -probcutBeta + 1, ply + 1);
+            if (score >= probcutBeta)
+                score = -search(engine, -probcutBeta, -probcutBeta + 1, probcutDepth, ply + 1, !cutNode);
+            undoMove(board, move);
+
+            if (engine->searchState == SEARCH_STOPPED) return SEARCH_STOPPED_SCORE;
+
+            // The capture beat our raised beta, so save the cutoff and prune.
+            if (score >= probcutBeta) {
+                hashTableStore(board->hash, ply, move, probcutDepth + 1, score, ss->staticEval, BOUND_LOWER);
+                return score;
+            }
+        }
+    }
+
     /**
      * Internal Iterative Reductions (IIR). (+13.2 elo)
      * Nodes without a hash move are usually less important, so it's likely safe
@@ -443,13 +562,26 @@ static int search(Engine *engine, PV *pv, int alpha, int beta, int depth, int pl
     int movesPlayed = 0;
     int quietsPlayed = 0;
 
+    // Quiet moves searched so far, which receive a malus on a quiet cutoff
+    Move quietsTried[MAX_LEGAL_MOVES];
+    int quietsTriedCount = 0;
+
     Move bestMove = NO_MOVE;
     int hashBound = BOUND_UPPER;
 
+    // If the hash move is a capture, the best move is likely tactical, so
+    // quiet moves are less likely to be good.
+    bool hashMoveIsCapture = hashMove != NO_MOVE && IsCapture(hashMove);
+
+    // Our pieces under threat, computed from the eval's attack info only once
+    // futility pruning actually needs them.
+    bool threatsKnown = false;
+    U64 threatened = 0ULL;
+
     // Create a move picker, which picks moves which look better first,
     // shortening our search by creating cutoffs.
     MovePicker picker;
-    initMovePicker(&picker, board, hashMove);
+    initMovePicker(&picker, hashMove, ss);
 
     Move move;
     while ((move = pickMove(&picker, board)) != NO_MOVE) {
@@ -468,16 +600,60 @@ static int search(Engine *engine, PV *pv, int alpha, int beta, int depth, int pl
             && !pvNode
             && IsQuiet(move)
             && !inCheck
-            && quietsPlayed >= LMP_TABLE[depth]
+            && quietsPlayed >= LMP_TABLE[improving][depth]
         ) break; // No captures exist after the first quiet in my ordering.
-        
+
+        /**
+         * Futility pruning.
+         * Near the horizon, if the static evaluation plus a generous margin for
+         * what a quiet move could gain still can't reach alpha, the quiet move
+         * is hopeless and we skip it without making it. We always search at
+         * least one move so mates and stalemates are still detected, and never
+         * prune moves which save a threatened piece.
+         * https://www.chessprogramming.org/Futility_Pruning
+         */
+        if (
+            depth <= FUTILITY_DEPTH
+            && !pvNode
+            && IsQuiet(move)
+            && !inCheck
+            && movesPlayed > 0
+            && eval + FUTILITY_BASE_MARGIN + FUTILITY_MARGIN * depth <= alpha
+        ) {
+            if (!threatsKnown) {
+                AttackInfo info;
+                computeAttackInfo(board, &info);
+                threatened = threatenedPieces(board, &info, board->side);
+                threatsKnown = true;
+            }
+
+            if (!testBit(threatened, MoveFrom(move)))
+                continue;
+        }
+
+        /**
+         * Gather information about the move before it's made, for use in late
+         * move reductions. Losing captures are found with SEE, but only when
+         * the capture could actually be reduced.
+         */
+        bool isQuietMove = !IsCapture(move);
+        int moveHistory = isQuietMove ? getMoveHistory(board, ss, move) : 0;
+        bool isBadCapture = !isQuietMove && movesPlayed > 0 && depth >= LMR_DEPTH
+            && !staticExchangeEvaluation(board, move, 0);
+
         // Skip illegal moves
+        int movedPiece = board->squares[MoveFrom(move)];
         if (makeMove(board, move) == 0) {
             undoMove(board, move);
             continue;
         }
         movesPlayed++;
         if (IsQuiet(move)) quietsPlayed++;
+        if (!IsCapture(move)) quietsTried[quietsTriedCount++] = move;
+
+        // Record the move on the search stack for our children
+        ss->move = move;
+        ss->continuationHistory = &continuationHistory[toPiece(movedPiece, !board->side)][MoveTo(move)];
 
         /**
          * At high depths we report the current root move that's being searched.
@@ -496,7 +672,7 @@ static int search(Engine *engine, PV *pv, int alpha, int beta, int depth, int pl
         int score;
         if (movesPlayed == 1) {
             // Full window search for the first move
-            score = -search(engine, &childPV, -beta, -alpha, depth - 1, ply + 1, false);
+            score = -search(engine, -beta, -alpha, depth - 1, ply + 1, false);
         } else {
 
             /**
@@ -504,18 +680,35 @@ static int search(Engine *engine, PV *pv, int alpha, int beta, int depth, int pl
              * Under the assumption that our move ordering is quite good, the
              * later moves in the move list are likely to be bad. Hence, we can
              * (probably) safely search them to a lower depth and save the time
-             * to search more important variations deeper.
+             * to search more important variations deeper. Quiet moves and
+             * losing captures are reduced, with the reduction adjusted by what
+             * we know about the move and the node.
              * https://www.chessprogramming.org/Late_Move_Reductions
              */
-
-            // Do not reduce killers because they are important.
-            bool isKillerMove = (move == picker.killerOne || move == picker.killerTwo);
-
-            // Compute depth reduction for LMR
             int reducedDepth = depth - 1;
-            if (IsQuiet(move) && !inCheck && !isKillerMove) {
+            if (depth >= LMR_DEPTH && !inCheck && (IsQuiet(move) || isBadCapture)) {
                 // Base depth and move-count based reduction
-                int reduction = LMR_TABLE[depth][movesPlayed];
+                int reduction = LMR_TABLE[IsQuiet(move)][depth][movesPlayed];
+
+                if (IsQuiet(move)) {
+                    // Reduce moves with good history less, and bad history more
+                    reduction -= moveHistory / LMR_HISTORY_DIVISOR;
+
+                    // Reduce killers less because they are important
+                    reduction -= (move == picker.killerOne || move == picker.killerTwo);
+
+                    // A capture hash move suggests quiets won't be best here
+                    reduction += hashMoveIsCapture;
+                }
+
+                // Reduce less in PV nodes
+                reduction -= pvNode;
+
+                // Reduce more when the position isn't getting better
+                reduction += !improving;
+
+                // Reduce more in expected cut nodes, a fail high is likely to come from an earlier move
+                reduction += cutNode;
 
                 // Apply the reduction then clamp so we don't accidentally extend
                 // or go into negative depths
@@ -524,15 +717,20 @@ static int search(Engine *engine, PV *pv, int alpha, int beta, int depth, int pl
             }
 
             // Null window search for non PV moves.
-            score = -search(engine, &childPV, -alpha - 1, -alpha, reducedDepth, ply + 1, true);
+            score = -search(engine, -alpha - 1, -alpha, reducedDepth, ply + 1, true);
+
+            // If a reduced move beats alpha, verify it at full depth.
+            if (score > alpha && reducedDepth < depth - 1) {
+                score = -search(engine, -alpha - 1, -alpha, depth - 1, ply + 1, !cutNode);
+            }
 
             /**
-             * If the move failed high, we need to re-search with a full window
-             * and at full depth, since the move beat our best score and we need
+             * If the move is inside the window in a PV node, we need to re-search
+             * with a full window since the move beat our best score and we need
              * its precise value.
              */
-            if (score > alpha) {
-                score = -search(engine, &childPV, -beta, -alpha, depth - 1, ply + 1, !cutNode);
+            if (pvNode && score > alpha) {
+                score = -search(engine, -beta, -alpha, depth - 1, ply + 1, false);
             }
         }
         undoMove(board, move);
@@ -560,9 +758,9 @@ static int search(Engine *engine, PV *pv, int alpha, int beta, int depth, int pl
                  * https://web.archive.org/web/20040620092229/http://www.brucemo.com/compchess/programming/pv.htm
                  * https://www.chessprogramming.org/Principal_Variation
                  */
-                pv->length = 1 + childPV.length;
+                pv->length = 1 + childPV->length;
                 pv->moves[0] = move;
-                memcpy(pv->moves + 1, childPV.moves, sizeof(Move) * childPV.length);
+                memcpy(pv->moves + 1, childPV->moves, sizeof(Move) * childPV->length);
 
                 /**
                  * Fail high cutoff.
@@ -583,20 +781,19 @@ static int search(Engine *engine, PV *pv, int alpha, int beta, int depth, int pl
                      */
                     if (!IsCapture(move)) {
                         // Apply a history bonus to this move.
-                        updateMoveHistory(board, move, depth, false);
+                        updateMoveHistory(board, ss, move, depth, false);
 
                         /**
                          * History Malus. (+39.01 elo +/- 13.66)
-                         * Apply a history penalty to the moves before this one,
+                         * Apply a history penalty to the quiets before this one,
                          * to incentivize the program to pick this move earlier.
                          * https://www.chessprogramming.org/History_Heuristic#History_Maluses
                          */
-                        for (int i = 0; i < movesPlayed - 1; i++) {
-                            Move malusMove = picker.moveList.list[i];
-                            updateMoveHistory(board, malusMove, depth, true);
+                        for (int i = 0; i < quietsTriedCount - 1; i++) {
+                            updateMoveHistory(board, ss, quietsTried[i], depth, true);
                         }
 
-                        updateKillers(ply, move);
+                        updateKillers(ss, move);
                     }
                     break;
                 }
@@ -617,7 +814,7 @@ static int search(Engine *engine, PV *pv, int alpha, int beta, int depth, int pl
 
 
     // Store the results of this search in the hash table
-    hashTableStore(board->hash, ply, bestMove, depth, bestScore, hashBound);
+    hashTableStore(board->hash, ply, bestMove, depth, bestScore, ss->staticEval, hashBound);
     
     // Propogate the best score we found up the tree.
     return bestScore;
@@ -680,7 +877,7 @@ static void printSearchInfo(int depth, int score, Engine *engine) {
  * score, only expanding the window if the score falls outside the guessed bound.
  * https://www.chessprogramming.org/Aspiration_Windows
  */
-int aspirationWindow(Engine *engine, PV *pv, int depth, int lastScore) {
+int aspirationWindow(Engine *engine, int depth, int lastScore) {
     // Reset this ply's search stats
     engine->searchStats.seldepth = 0;
 
@@ -697,10 +894,10 @@ int aspirationWindow(Engine *engine, PV *pv, int depth, int lastScore) {
             int beta = lastScore + betaMargin;
 
             // Search with this window
-            int score = search(engine, pv, alpha, beta, depth, 0, false);
+            int score = search(engine, alpha, beta, depth, 0, false);
             
-            // Break out quickly if we're out of time
-            if (getTime() > engine->limits.hardBoundTime)
+            // Break out quickly if we're out of time (or nodes)
+            if (engine->searchState == SEARCH_STOPPED)
                 return SEARCH_STOPPED_SCORE;
             
             // Return our score if it was in the window
@@ -716,14 +913,106 @@ int aspirationWindow(Engine *engine, PV *pv, int depth, int lastScore) {
     }
 
     // Full window search if we fall out of [-500, 500]
-    return search(engine, pv, -INF_SCORE, INF_SCORE, depth, 0, false);
+    return search(engine, -INF_SCORE, INF_SCORE, depth, 0, false);
+}
+
+// Follows hash moves from the root as far as depth, for searches which don't collect a PV
+static void hashPV(Engine *engine, PV *pv, int depth) {
+    Board *board = &engine->board;
+    pv->length = 0;
+
+    while (pv->length < depth) {
+        Move move = probeHashMove(board->hash);
+
+        MoveList moves;
+        generatePseudoLegalMoves(&moves, board);
+        bool found = false;
+        for (int i = 0; i < moves.count && !found; i++)
+            found = moves.list[i] == move;
+
+        if (!found)
+            break;
+        if (!makeMove(board, move) || isDraw(board, pv->length + 1)) {
+            undoMove(board, move);
+            break;
+        }
+        pv->moves[pv->length++] = move;
+    }
+
+    for (int i = pv->length - 1; i >= 0; i--)
+        undoMove(board, pv->moves[i]);
+}
+
+/**
+ * MTD(f), with bisection (MTD-bi) once the score is bounded from both sides.
+ * Finds the score with null window searches only, starting at a guess such as
+ * the last iteration's score, and relies on the hash table to keep the work
+ * of earlier searches so the ones after are cheap. Search mostly returns the
+ * bound it was given, so while the score is only bounded from one side the
+ * window steps away from that bound by a growing step, and once it's bounded
+ * from both sides the window goes halfway between them.
+ * https://www.chessprogramming.org/MTD(f)
+ */
+int mtdf(Engine *engine, int depth, int guess) {
+    // Reset this ply's search stats
+    engine->searchStats.seldepth = 0;
+
+    int lowerBound = -INF_SCORE;
+    int upperBound = INF_SCORE;
+    int step = MTDF_START_STEP;
+    int beta = MAX(guess, -MATE_SCORE + 1);
+
+    while (true) {
+        int score = search(engine, beta - 1, beta, depth, 0, false);
+
+        // Break out quickly if we're out of time (or nodes)
+        if (engine->searchState == SEARCH_STOPPED)
+            return SEARCH_STOPPED_SCORE;
+
+        if (score < beta)
+            upperBound = score;
+        else
+            lowerBound = score;
+
+        // Null window searches don't collect a PV, so it's taken from the hash table
+        if (lowerBound >= upperBound) {
+            hashPV(engine, &engine->searchStack[SEARCH_STACK_OFFSET].pv, depth);
+            return score;
+        }
+
+        // Move the window for the next search
+        if (lowerBound > -INF_SCORE && upperBound < INF_SCORE) {
+            beta = lowerBound + (upperBound - lowerBound + 1) / 2;
+        } else {
+            beta = (score < beta) ? MAX(upperBound - step + 1, -INF_SCORE + 1) : MIN(lowerBound + step, INF_SCORE);
+            step *= MTDF_SCALE_FACTOR;
+        }
+    }
+}
+
+/**
+ * Shallow iterative deepening without output, for other search drivers to
+ * evaluate positions with (see mcts.h). Returns the score of the last depth
+ * finished within the engine's limits, for the side to move.
+ */
+int rolloutSearch(Engine *engine, int depth) {
+    int score = evaluate(&engine->board);
+
+    for (int d = 1; d <= depth; d++) {
+        int result = search(engine, -INF_SCORE, INF_SCORE, d, 0, false);
+        if (engine->searchState == SEARCH_STOPPED)
+            break;
+        score = result;
+    }
+
+    return score;
 }
 
 // Iterative deepening loop
 // https://www.chessprogramming.org/Iterative_Deepening
 Move iterativeDeepening(Engine *engine) {
     SearchLimits *limits = &engine->limits;
-    PV currentPV = {0};
+    PV *rootPV = &engine->searchStack[SEARCH_STACK_OFFSET].pv;
 
     // Our current best estimate of the root score
     // The aspiration window after a certain depth is centered around this score.
@@ -737,21 +1026,23 @@ Move iterativeDeepening(Engine *engine) {
             break;
 
         // Run a search at this depth
-        int score = aspirationWindow(engine, &currentPV, depth, rootScore);
+        int score = (searchMode == SEARCH_MODE_MTDF) ? mtdf(engine, depth, rootScore)
+                                                     : aspirationWindow(engine, depth, rootScore);
 
         // Update the root score
         if (score != SEARCH_STOPPED_SCORE)
-            rootScore = score;
+            rootScore = engine->searchStats.score = score;
 
         // Update our PV if a full line can be recovered from this search.
-        if (currentPV.length > 0)
-            engine->pv = currentPV;
+        if (rootPV->length > 0)
+            engine->pv = *rootPV;
 
         // Print this iteration's info string
-        printSearchInfo(depth, rootScore, engine);
+        if (!engine->silent)
+            printSearchInfo(depth, rootScore, engine);
 
         // Turn on currmove reporting after some time has passed
-        if (getTime() > engine->limits.searchStartTime + REPORT_CURRMOVE_AFTER)
+        if (!engine->silent && getTime() > engine->limits.searchStartTime + REPORT_CURRMOVE_AFTER)
             engine->reportCurrMove = true;
     }
     engine->searchState = SEARCH_STOPPED;
@@ -765,8 +1056,8 @@ Move iterativeDeepening(Engine *engine) {
     return engine->pv.moves[0];
 }
 
-// Gets the engine ready to search, with given limits.
-void initSearch(Engine *engine, SearchLimits limits) {
+// Resets the engine's search state for a search with the given limits, but keeps the histories.
+void resetSearch(Engine *engine, SearchLimits limits) {
     // Clear the principal variation
     engine->pv.length = 0;
     memset(engine->pv.moves, NO_MOVE, sizeof(engine->pv.moves));
@@ -775,13 +1066,29 @@ void initSearch(Engine *engine, SearchLimits limits) {
     engine->searchStats.nodes = 0;
     engine->searchStats.searchStartTime = getTime();
     engine->searchStats.seldepth = 0;
+    engine->searchStats.score = 0;
 
     // Set engine state and search limits
     engine->searchState = SEARCHING;
     engine->limits = limits;
     engine->reportCurrMove = false;
 
-    // Clear move ordering heuristics
-    clearMoveHistory();
-    clearKillerMoves();
+    // Reset the search stack, including the sentinels before the root
+    for (int i = 0; i < MAX_PLY + SEARCH_STACK_OFFSET; i++) {
+        SearchStack *ss = &engine->searchStack[i];
+        ss->pv.length = 0;
+        ss->staticEval = EVAL_NONE;
+        ss->move = NO_MOVE;
+        ss->killers[0] = ss->killers[1] = NO_MOVE;
+        ss->continuationHistory = NULL;
+    }
+}
+
+// Gets the engine ready to search, with given limits.
+void initSearch(Engine *engine, SearchLimits limits) {
+    resetSearch(engine, limits);
+    resetPawnTableStats();
+
+    // Age move ordering heuristics from the previous search
+    ageMoveHistory();
 }
@@ -11,6 +11,9 @@
 // If abs(score) > MATE_BOUND then mate was found.
 #define MATE_BOUND 98900
 
+// Static evaluation of nodes which don't have one (e.g. in check)
+#define EVAL_NONE (INF_SCORE + 1)
+
 // Search limits
 #define MAX_DEPTH 100
 
@@ -37,13 +40,26 @@ static const int SEE_PIECE_VALUES[NB_PIECES + 1] = {
 #define LMP_PRODUCT 1
 
 // Late move reduction formula
+#define LMR_DEPTH 2
 #define LMR_BASE_REDUCTION 0.25
 #define LMR_DIVISOR 2.6
+#define LMR_CAPTURE_BASE_REDUCTION 0.0
+#define LMR_CAPTURE_DIVISOR 3.2
+#define LMR_HISTORY_DIVISOR 8192
 
 // Reverse futility pruning
 #define REVERSE_FUTILITY_DEPTH 6
 #define REVERSE_FUTILITY_MARGIN 150
 
+// Futility pruning
+#define FUTILITY_DEPTH 6
+#define FUTILITY_BASE_MARGIN 80
+#define FUTILITY_MARGIN 90
+
+// Razoring
+#define RAZOR_DEPTH 3
+#define RAZOR_MARGIN 250
+
 // Null move pruning
 #define NULL_MOVE_PRUNING_DEPTH 3
 #define NULL_REDUCTION_BASE 4
@@ -52,6 +68,11 @@ static const int SEE_PIECE_VALUES[NB_PIECES + 1] = {
 // Delta pruning
 #define DELTA_PRUNE_MARGIN 150
 
+// ProbCut
+#define PROBCUT_DEPTH 5
+#define PROBCUT_MARGIN 200
+#define PROBCUT_REDUCTION 4
+
 // Internal iterative reductions
 #define IIR_DEPTH 3
 
@@ -59,11 +80,31 @@ static const int SEE_PIECE_VALUES[NB_PIECES + 1] = {
 #define ASPIRATION_START_SIZE 10
 #define ASPIRATION_SCALE_FACTOR 2
 
+// MTD(f) steps, while the score is only bounded from one side
+#define MTDF_START_STEP 8
+#define MTDF_SCALE_FACTOR 2
+
 /* -------------------------------------------------------------------------- */
 /*                              Search functions                              */
 /* -------------------------------------------------------------------------- */
 
+// Root search drivers, selected with the SearchMode UCI option
+typedef enum {
+    SEARCH_MODE_ALPHA_BETA,
+    SEARCH_MODE_MTDF,
+    SEARCH_MODE_MCTS
+} SearchMode;
+
+extern SearchMode searchMode;
+extern int searchThreads;
+
+int isMateScore(int score);
+int checkSearchOver(Engine *engine);
 void printCurrentMove(int depth, Move move, int movesPlayed);
+int aspirationWindow(Engine *engine, int depth, int lastScore);
+int mtdf(Engine *engine, int depth, int guess);
+int rolloutSearch(Engine *engine, int depth);
 Move iterativeDeepening(Engine *engine);
+void resetSearch(Engine *engine, SearchLimits limits);
 void initSearch(Engine *engine, SearchLimits limits);
 void initSearchTables();
@@ -0,0 +1,647 @@
+#include <assert.h>
+#include <math.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "tune.h"
+#include "board.h"
+#include "bitboards.h"
+#include "chain.h"
+#include "eval.h"
+#include "makemove.h"
+#include "material.h"
+#include "movepicker.h"
+#include "packed.h"
+#include "search.h"
+#include "sliders.h"
+#include "utils.h"
+
+// Longest dataset line we look at, anything after this is ignored
+#define TUNE_LINE_SIZE 256
+
+// Adam optimiser, https://arxiv.org/abs/1412.6980
+#define TUNE_LEARNING_RATE 1.0
+#define TUNE_BETA1 0.9
+#define TUNE_BETA2 0.999
+#define TUNE_EPSILON 1e-8
+
+// How often to report the loss and save the weights
+#define TUNE_REPORT_EPOCHS 50
+
+/* -------------------------------------------------------------------------- */
+/*                                Tuned Weights                               */
+/* -------------------------------------------------------------------------- */
+
+// Index of each tuned weight
+enum {
+    TUNE_MATERIAL = 0,                                      // Pawn to queen
+    TUNE_PSQT = TUNE_MATERIAL + KING,                       // Every piece and square
+    TUNE_MOBILITY = TUNE_PSQT + NB_PIECES * 64,             // Knight to queen
+    TUNE_BISHOP_PAIR = TUNE_MOBILITY + QUEEN - KNIGHT + 1,
+    TUNE_TEMPO,
+    NB_TUNE_WEIGHTS
+};
+
+enum { MG, EG };
+
+typedef double Weights[NB_TUNE_WEIGHTS][2];
+
+static void setWeight(Weights weights, int index, int score) {
+    weights[index][MG] = ScoreMG(score);
+    weights[index][EG] = ScoreEG(score);
+}
+
+// Starts from the weights the engine currently uses.
+static void initWeights(Weights weights) {
+    for (int piece = PAWN; piece <= QUEEN; piece++)
+        setWeight(weights, TUNE_MATERIAL + piece, MATERIAL_VALUES[piece]);
+
+    for (int piece = PAWN; piece <= KING; piece++) {
+        for (int sq = 0; sq < 64; sq++)
+            setWeight(weights, TUNE_PSQT + piece * 64 + sq, PSQT_BASE[piece][sq]);
+    }
+
+    for (int piece = KNIGHT; piece <= QUEEN; piece++)
+        setWeight(weights, TUNE_MOBILITY + piece - KNIGHT, MOBILITY_VALUES[piece]);
+
+    setWeight(weights, TUNE_BISHOP_PAIR, BISHOP_PAIR_VALUE);
+    setWeight(weights, TUNE_TEMPO, TEMPO);
+}
+
+/**
+ * How many times each weight is added to the evaluation of this position, from
+ * White's POV. This has to mirror what evaluatePacked() does with them.
+ */
+static void computeCoefficients(Board *board, int coefficients[NB_TUNE_WEIGHTS]) {
+    memset(coefficients, 0, NB_TUNE_WEIGHTS * sizeof(int));
+    U64 occupied = board->colors[BOTH];
+
+    for (int color = WHITE; color <= BLACK; color++) {
+        int sign = (color == WHITE) ? 1 : -1;
+
+        for (int piece = PAWN; piece <= KING; piece++) {
+            U64 pieces = board->pieces[piece] & board->colors[color];
+            while (pieces) {
+                int sq = poplsb(&pieces);
+
+                // Material and PSQT, see initEvaluation() for the mirroring
+                if (piece != KING)
+                    coefficients[TUNE_MATERIAL + piece] += sign;
+                int psqtSquare = (color == WHITE) ? MIRROR_SQ(sq) : sq;
+                coefficients[TUNE_PSQT + piece * 64 + psqtSquare] += sign;
+
+                // Mobility
+                if (piece >= KNIGHT && piece <= QUEEN) {
+                    U64 attacks = (piece == KNIGHT) ? knightAttacks(sq)
+                                : (piece == BISHOP) ? bishopAttacks(sq, occupied)
+                                : (piece == ROOK)   ? rookAttacks(sq, occupied)
+                                :                     queenAttacks(sq, occupied);
+                    coefficients[TUNE_MOBILITY + piece - KNIGHT] += sign * popCount(attacks);
+                }
+            }
+        }
+
+        if (popCount(board->pieces[BISHOP] & board->colors[color]) == 2)
+            coefficients[TUNE_BISHOP_PAIR] += sign;
+    }
+
+    coefficients[TUNE_TEMPO] = (board->side == WHITE) ? 1 : -1;
+}
+
+/* -------------------------------------------------------------------------- */
+/*                                   Dataset                                  */
+/* -------------------------------------------------------------------------- */
+
+// A non zero coefficient of a position
+typedef struct {
+    uint16_t index;
+    int16_t value;
+} TuneCoefficient;
+
+// A position of the dataset, with everything needed to evaluate it for any weights
+typedef struct {
+    uint32_t start;           // First coefficient in the shard's coefficient array
+    uint16_t count;           // Number of coefficients
+    uint8_t phase;
+    uint8_t scale;            // Endgame scale factor, out of SCALE_NORMAL
+    int16_t restMG, restEG;   // Evaluation terms which aren't tuned, from White's POV
+    float result;             // Game result from White's POV
+} TuneEntry;
+
+/**
+ * Each thread loads and works on its own part of the dataset, so there is no
+ * sharing between threads until the gradients are added up.
+ */
+typedef struct {
+    // Lines of the dataset to load, packed positions if lineStarts is NULL, or chained games
+    const char *data;
+    const size_t *lineStarts;
+    size_t firstLine, lineCount;
+    bool chained;
+
+    // Loaded positions
+    TuneEntry *entries;
+    size_t entryCount, entryCapacity;
+    TuneCoefficient *coefficients;
+    size_t coefficientCount, coefficientCapacity;
+
+    // Input and output of each pass over the positions
+    Weights *weights;
+    double K;
+    bool computeGradient;
+    double loss;
+    Weights gradient;
+} TuneShard;
+
+// Weights the engine uses right now, to work out the terms that aren't tuned
+static Weights initialWeights;
+
+// Game result from White's POV in a dataset line, or -1 if there isn't one.
+static double parseResult(const char *line) {
+    const char *bracket = strchr(line, '[');
+    if (bracket != NULL)
+        return strtod(bracket + 1, NULL);
+
+    if (strstr(line, "1/2-1/2"))
+        return 0.5;
+    if (strstr(line, "1-0"))
+        return 1.0;
+    if (strstr(line, "0-1"))
+        return 0.0;
+
+    return -1.0;
+}
+
+/**
+ * A plain quiescence search on the hand crafted eval, which keeps track of its
+ * PV so we can find the quiet position that its score comes from.
+ */
+static int quietSearch(Board *board, int alpha, int beta, int ply, PV *pv) {
+    pv->length = 0;
+
+    int standPat = evaluateClassical(board);
+    if (standPat >= beta || ply >= MAX_PLY - 1)
+        return standPat;
+    if (standPat > alpha)
+        alpha = standPat;
+
+    int bestScore = standPat;
+    MovePicker picker;
+    initMovePicker(&picker, NO_MOVE, NULL);
+
+    Move move;
+    PV childPv;
+    while ((move = pickMove(&picker, board)) != NO_MOVE) {
+        if (!IsCapture(move)) break;
+
+        if (makeMove(board, move) == 0) {
+            undoMove(board, move);
+            continue;
+        }
+
+        int score = -quietSearch(board, -beta, -alpha, ply + 1, &childPv);
+        undoMove(board, move);
+
+        if (score > bestScore) {
+            bestScore = score;
+
+            if (score > alpha) {
+                alpha = score;
+
+                pv->moves[0] = move;
+                memcpy(pv->moves + 1, childPv.moves, childPv.length * sizeof(Move));
+                pv->length = childPv.length + 1;
+
+                if (alpha >= beta)
+                    break;
+            }
+        }
+    }
+
+    return bestScore;
+}
+
+// Evaluation of a position with the given weights, from White's POV
+static double entryEval(TuneShard *shard, TuneEntry *entry, Weights weights) {
+    double mg = entry->restMG;
+    double eg = entry->restEG;
+
+    for (int i = 0; i < entry->count; i++) {
+        TuneCoefficient *coefficient = &shard->coefficients[entry->start + i];
+        mg += coefficient->value * weights[coefficient->index][MG];
+        eg += coefficient->value * weights[coefficient->index][EG];
+    }
+
+    eg = eg * entry->scale / SCALE_NORMAL;
+    return (mg * entry->phase + eg * (PHASE_MAX - entry->phase)) / PHASE_MAX;
+}
+
+// Adds a quiet position to the shard.
+static void addEntry(TuneShard *shard, Board *board, double result) {
+    int coefficients[NB_TUNE_WEIGHTS];
+    computeCoefficients(board, coefficients);
+
+    // Everything the tuned weights don't account for stays fixed
+    int sideSign = (board->side == WHITE) ? 1 : -1;
+    int packed = sideSign * evaluatePacked(board);
+
+    double restMG = ScoreMG(packed);
+    double restEG = ScoreEG(packed);
+    int count = 0;
+    for (int i = 0; i < NB_TUNE_WEIGHTS; i++) {
+        if (coefficients[i] == 0)
+            continue;
+
+        restMG -= coefficients[i] * initialWeights[i][MG];
+        restEG -= coefficients[i] * initialWeights[i][EG];
+        count++;
+    }
+
+    // The endgame scale factor depends on who is ahead, which we assume doesn't change
+    MaterialEntry *material = probeMaterial(board);
+    int scale = SCALE_NORMAL;
+    if (material->special)
+        scale = scaleFactor(board, material, ScoreEG(sideSign * packed) > 0 ? board->side : !board->side);
+
+    // Make room for the new position
+    if (shard->entryCount == shard->entryCapacity) {
+        shard->entryCapacity = MAX(1024, 2 * shard->entryCapacity);
+        shard->entries = realloc(shard->entries, shard->entryCapacity * sizeof(TuneEntry));
+    }
+    if (shard->coefficientCount + count > shard->coefficientCapacity) {
+        shard->coefficientCapacity = MAX(65536, 2 * shard->coefficientCapacity);
+        shard->coefficients = realloc(shard->coefficients, shard->coefficientCapacity * sizeof(TuneCoefficient));
+    }
+
+    TuneEntry *entry = &shard->entries[shard->entryCount++];
+    entry->start = shard->coefficientCount;
+    entry->count = count;
+    entry->phase = getGamePhase(board);
+    entry->scale = scale;
+    entry->restMG = lround(restMG);
+    entry->restEG = lround(restEG);
+    entry->result = result;
+
+    for (int i = 0; i < NB_TUNE_WEIGHTS; i++) {
+        if (coefficients[i] != 0) {
+            TuneCoefficient *coefficient = &shard->coefficients[shard->coefficientCount++];
+            coefficient->index = i;
+            coefficient->value = coefficients[i];
+        }
+    }
+
+    // With the current weights we should get the engine's evaluation back, give or take rounding
+    assert(fabs(entryEval(shard, entry, initialWeights) - sideSign * evaluateClassical(board)) <= 2.0);
+}
+
+// Resolves a dataset position to a quiet one and adds it to the shard, leaving the board as it was.
+static void loadPosition(TuneShard *shard, Board *board, double result) {
+    PV pv;
+    quietSearch(board, -INF_SCORE, INF_SCORE, 0, &pv);
+    for (int ply = 0; ply < pv.length; ply++)
+        makeMove(board, pv.moves[ply]);
+
+    // Known endgames don't use the normal evaluation at all
+    if (!probeMaterial(board)->evaluate)
+        addEntry(shard, board, result);
+
+    for (int ply = pv.length - 1; ply >= 0; ply--)
+        undoMove(board, pv.moves[ply]);
+}
+
+// Thread which loads its lines of the dataset.
+static void *loadShard(void *arg) {
+    TuneShard *shard = arg;
+    Board *board = malloc(sizeof(Board));
+    char line[TUNE_LINE_SIZE];
+
+    // Chained games are read in one go, they're only split between shards at game boundaries
+    if (shard->chained) {
+        size_t start = shard->lineStarts[shard->firstLine];
+        size_t end = shard->lineStarts[shard->firstLine + shard->lineCount];
+        ChainReader reader;
+        chainReaderInit(&reader, (const uint8_t *) shard->data + start, end - start);
+
+        int score, result;
+        while (chainReaderNext(&reader, board, &score, &result))
+            loadPosition(shard, board, result / 2.0);
+
+        free(board);
+        return NULL;
+    }
+
+    for (size_t i = shard->firstLine; i < shard->firstLine + shard->lineCount; i++) {
+        if (shard->lineStarts == NULL) {
+            const PackedBoard *packed = (const PackedBoard *) shard->data + i;
+            unpackBoard(packed, board);
+            loadPosition(shard, board, packed->result / 2.0);
+            continue;
+        }
+
+        size_t length = MIN(shard->lineStarts[i + 1] - shard->lineStarts[i], sizeof(line) - 1);
+        memcpy(line, shard->data + shard->lineStarts[i], length);
+        line[length] = '\0';
+
+        double result = parseResult(line);
+        if (result < 0.0 || result > 1.0)
+            continue;
+
+        parseFen(board, line);
+        loadPosition(shard, board, result);
+    }
+
+    free(board);
+    return NULL;
+}
+
+/* -------------------------------------------------------------------------- */
+/*                                Optimisation                                */
+/* -------------------------------------------------------------------------- */
+
+static double sigmoid(double K, double eval) {
+    return 1.0 / (1.0 + exp(-K * eval / 400.0));
+}
+
+/**
+ * Thread which adds up the squared error of its positions, and optionally the
+ * gradient of the error with respect to each weight.
+ */
+static void *evaluateShard(void *arg) {
+    TuneShard *shard = arg;
+    shard->loss = 0.0;
+    if (shard->computeGradient)
+        memset(shard->gradient, 0, sizeof(Weights));
+
+    for (size_t i = 0; i < shard->entryCount; i++) {
+        TuneEntry *entry = &shard->entries[i];
+        double prediction = sigmoid(shard->K, entryEval(shard, entry, *shard->weights));
+        double error = entry->result - prediction;
+        shard->loss += error * error;
+
+        if (!shard->computeGradient)
+            continue;
+
+        // Chain rule through the sigmoid and the taper
+        double slope = -2.0 * error * prediction * (1.0 - prediction) * shard->K / 400.0;
+        double mgSlope = slope * entry->phase / PHASE_MAX;
+        double egSlope = slope * (PHASE_MAX - entry->phase) / PHASE_MAX * entry->scale / SCALE_NORMAL;
+
+        for (int j = 0; j < entry->count; j++) {
+            TuneCoefficient *coefficient = &shard->coefficients[entry->start + j];
+            shard->gradient[coefficient->index][MG] += coefficient->value * mgSlope;
+            shard->gradient[coefficient->index][EG] += coefficient->value * egSlope;
+        }
+    }
+
+    return NULL;
+}
+
+// Runs a thread on every shard and waits for them all to finish.
+static void runShards(TuneShard *shards, int threads, void *(*work)(void *)) {
+    pthread_t *handles = malloc(threads * sizeof(pthread_t));
+
+    for (int i = 0; i < threads; i++)
+        pthread_create(&handles[i], NULL, work, &shards[i]);
+    for (int i = 0; i < threads; i++)
+        pthread_join(handles[i], NULL);
+
+    free(handles);
+}
+
+// Mean squared error over the whole dataset, and its gradient if asked for.
+static double datasetLoss(TuneShard *shards, int threads, Weights weights, double K, Weights gradient) {
+    for (int i = 0; i < threads; i++) {
+        shards[i].weights = (Weights *) weights;
+        shards[i].K = K;
+        shards[i].computeGradient = (gradient != NULL);
+    }
+
+    runShards(shards, threads, evaluateShard);
+
+    size_t positions = 0;
+    double loss = 0.0;
+    if (gradient != NULL)
+        memset(gradient, 0, sizeof(Weights));
+
+    for (int i = 0; i < threads; i++) {
+        positions += shards[i].entryCount;
+        loss += shards[i].loss;
+
+        if (gradient == NULL)
+            continue;
+
+        for (int j = 0; j < NB_TUNE_WEIGHTS; j++) {
+            gradient[j][MG] += shards[i].gradient[j][MG];
+            gradient[j][EG] += shards[i].gradient[j][EG];
+        }
+    }
+
+    if (gradient != NULL) {
+        for (int j = 0; j < NB_TUNE_WEIGHTS; j++) {
+            gradient[j][MG] /= positions;
+            gradient[j][EG] /= positions;
+        }
+    }
+
+    return loss / positions;
+}
+
+/**
+ * Finds the sigmoid scaling constant K which best fits the current weights, so
+ * that the tuner doesn't just scale every weight up or down. The loss is
+ * convex in K, so a ternary search does the job.
+ */
+static double findBestK(TuneShard *shards, int threads, Weights weights) {
+    double low = 0.0;
+    double high = 10.0;
+
+    while (high - low > 0.001) {
+        double third = (high - low) / 3.0;
+        if (datasetLoss(shards, threads, weights, low + third, NULL) < datasetLoss(shards, threads, weights, high - third, NULL))
+            high = high - third;
+        else
+            low = low + third;
+    }
+
+    return (low + high) / 2.0;
+}
+
+/* -------------------------------------------------------------------------- */
+/*                                   Output                                   */
+/* -------------------------------------------------------------------------- */
+
+static void printWeight(FILE *file, Weights weights, int index, int width) {
+    fprintf(file, "S(%*ld, %*ld)", width, lround(weights[index][MG]), width, lround(weights[index][EG]));
+}
+
+// Writes the weights in the same format as eval.h, ready to be copied over.
+static void writeWeights(Weights weights, const char *path) {
+    const char *pieceNames[NB_PIECES] = {"Pawn", "Knight", "Bishop", "Rook", "Queen", "King"};
+    const char *tableNames[NB_PIECES] = {"PAWN", "KNIGHT", "BISHOP", "ROOK", "QUEEN", "KING"};
+    FILE *file = fopen(path, "w");
+    if (file == NULL) {
+        printf("Could not write weights to %s\n", path);
+        return;
+    }
+
+    fprintf(file, "// Evaluation weights from the Texel tuner, to be copied into eval.h\n\n");
+
+    fprintf(file, "static const int TEMPO = ");
+    printWeight(file, weights, TUNE_TEMPO, 0);
+    fprintf(file, ";\n\n");
+
+    fprintf(file, "// Material values for each piece\n");
+    fprintf(file, "static const int MATERIAL_VALUES[NB_PIECES] = {\n");
+    for (int piece = PAWN; piece <= QUEEN; piece++) {
+        fprintf(file, "    ");
+        printWeight(file, weights, TUNE_MATERIAL + piece, 5);
+        fprintf(file, ", // %s\n", pieceNames[piece]);
+    }
+    fprintf(file, "    S(    0,     0)  // King\n};\n\n");
+
+    fprintf(file, "// Mobility values for each piece\n");
+    fprintf(file, "static const int MOBILITY_VALUES[NB_PIECES] = {\n");
+    fprintf(file, "    S(  0,   0), // Pawn\n");
+    for (int piece = KNIGHT; piece <= QUEEN; piece++) {
+        fprintf(file, "    ");
+        printWeight(file, weights, TUNE_MOBILITY + piece - KNIGHT, 3);
+        fprintf(file, ", // %s\n", pieceNames[piece]);
+    }
+    fprintf(file, "    S(  0,   0)  // King\n};\n\n");
+
+    fprintf(file, "static const int BISHOP_PAIR_VALUE = ");
+    printWeight(file, weights, TUNE_BISHOP_PAIR, 0);
+    fprintf(file, ";\n\n");
+
+    fprintf(file, "// Piece square tables (from Black POV for easier reading).\n");
+    fprintf(file, "static const int PSQT_BASE[NB_PIECES][64] = {\n");
+    for (int piece = PAWN; piece <= KING; piece++) {
+        fprintf(file, "    // %s\n    {\n", tableNames[piece]);
+        for (int sq = 0; sq < 64; sq++) {
+            if (sq % 8 == 0)
+                fprintf(file, "        ");
+            printWeight(file, weights, TUNE_PSQT + piece * 64 + sq, 3);
+            fprintf(file, (sq % 8 == 7) ? ", \n" : ", ");
+        }
+        fprintf(file, "    },\n");
+    }
+    fprintf(file, "};\n");
+
+    fclose(file);
+}
+
+/* -------------------------------------------------------------------------- */
+/*                                    Tuner                                   */
+/* -------------------------------------------------------------------------- */
+
+// Tunes the evaluation weights on a dataset, see tune.h.
+void tune(const char *path, int epochs, int threads) {
+    int start = getTime();
+
+    size_t size;
+    const char *data = mapFile(path, &size);
+    if (data == NULL) {
+        printf("Could not open dataset %s\n", path);
+        return;
+    }
+
+    // Packed datasets from datagen are just an array of positions
+    bool packed = hasExtension(path, ".bin");
+
+    bool chained = hasExtension(path, ".chain");
+
+    // Otherwise find where every line (or game) starts, with an extra one for the end of the file
+    size_t lineCount = packed ? size / sizeof(PackedBoard) : 0;
+    size_t lineCapacity = 1024;
+    size_t *lineStarts = packed ? NULL : malloc(lineCapacity * sizeof(size_t));
+    for (size_t offset = 0; !packed && offset < size; lineCount++) {
+        if (lineCount + 1 >= lineCapacity) {
+            lineCapacity *= 2;
+            lineStarts = realloc(lineStarts, lineCapacity * sizeof(size_t));
+        }
+        lineStarts[lineCount] = offset;
+
+        if (chained) {
+            offset = MIN(offset + chainGameSize((const uint8_t *) data + offset), size);
+            continue;
+        }
+
+        const char *newline = memchr(data + offset, '\n', size - offset);
+        offset = (newline == NULL) ? size : (size_t) (newline - data) + 1;
+    }
+    if (!packed)
+        lineStarts[lineCount] = size;
+
+    // Split the lines between threads, and load them into compact positions
+    if (threads <= 0)
+        threads = cpuCount();
+    TuneShard *shards = calloc(threads, sizeof(TuneShard));
+    for (int i = 0; i < threads; i++) {
+        shards[i].data = data;
+        shards[i].lineStarts = lineStarts;
+        shards[i].chained = chained;
+        shards[i].firstLine = lineCount * i / threads;
+        shards[i].lineCount = lineCount * (i + 1) / threads - shards[i].firstLine;
+    }
+
+    initWeights(initialWeights);
+    printf("Loading %zu %s from %s with %d threads...\n", lineCount, packed ? "positions" : chained ? "games" : "lines", path, threads);
+    runShards(shards, threads, loadShard);
+
+    size_t positions = 0;
+    size_t memory = 0;
+    for (int i = 0; i < threads; i++) {
+        positions += shards[i].entryCount;
+        memory += shards[i].entryCount * sizeof(TuneEntry) + shards[i].coefficientCount * sizeof(TuneCoefficient);
+    }
+    unmapFile(data, size);
+    free(lineStarts);
+
+    printf("Loaded %zu positions (%.1f MB) in %d ms\n", positions, memory / 1048576.0, getTime() - start);
+    if (positions == 0) {
+        free(shards);
+        return;
+    }
+
+    // Fit K to the current weights, then keep it fixed
+    Weights weights;
+    initWeights(weights);
+    double K = findBestK(shards, threads, weights);
+    printf("K = %.3f, initial loss %.6f\n", K, datasetLoss(shards, threads, weights, K, NULL));
+
+    // Adam
+    static Weights gradient, momentum, velocity;
+    memset(momentum, 0, sizeof(Weights));
+    memset(velocity, 0, sizeof(Weights));
+
+    for (int epoch = 1; epoch <= epochs; epoch++) {
+        double loss = datasetLoss(shards, threads, weights, K, gradient);
+
+        for (int i = 0; i < NB_TUNE_WEIGHTS; i++) {
+            for (int phase = MG; phase <= EG; phase++) {
+                double g = gradient[i][phase];
+                momentum[i][phase] = TUNE_BETA1 * momentum[i][phase] + (1.0 - TUNE_BETA1) * g;
+                velocity[i][phase] = TUNE_BETA2 * velocity[i][phase] + (1.0 - TUNE_BETA2) * g * g;
+
+                double m = momentum[i][phase] / (1.0 - pow(TUNE_BETA1, epoch));
+                double v = velocity[i][phase] / (1.0 - pow(TUNE_BETA2, epoch));
+                weights[i][phase] -= TUNE_LEARNING_RATE * m / (sqrt(v) + TUNE_EPSILON);
+            }
+        }
+
+        if (epoch % TUNE_REPORT_EPOCHS == 0 || epoch == epochs) {
+            printf("Epoch %d, loss %.6f, %d ms\n", epoch, loss, getTime() - start);
+            writeWeights(weights, TUNE_OUTPUT_FILE);
+        }
+    }
+
+    printf("Tuned weights written to %s\n", TUNE_OUTPUT_FILE);
+
+    for (int i = 0; i < threads; i++) {
+        free(shards[i].entries);
+        free(shards[i].coefficients);
+    }
+    free(shards);
+}
@@ -0,0 +1,26 @@
+// Texel tuning of the hand crafted evaluation.
+//
+// Tunes material, PSQT, mobility, the bishop pair and tempo against the game
+// results of a labeled dataset, by minimising the error between the results
+// and a sigmoid of the evaluation. https://www.chessprogramming.org/Texel%27s_Tuning_Method
+//
+// The dataset has one position per line, a FEN (or EPD) followed by the result
+// from White's POV in any of these forms: [1.0] [0.5] [0.0], or 1-0 1/2-1/2 0-1
+// (e.g. c9 "1-0";). Files ending in .bin or .chain are read as packed
+// positions or chained games from datagen instead, see packed.h and chain.h.
+// Every position is first resolved to a quiet one with a small quiescence
+// search, and the evaluation of the quiet position is broken down into a linear
+// combination of the tuned weights, plus whatever the other terms add up to.
+// This is done once, so each epoch afterwards is just a few dot products per
+// position, spread over all cores.
+//
+// Usage: tune <dataset> [epochs] [threads]
+// Threads default to the number of cores. The result is written to tuned.h, in
+// the same format as eval.h.
+
+#pragma once
+
+#define TUNE_DEFAULT_EPOCHS 2000
+#define TUNE_OUTPUT_FILE "tuned.h"
+
+void tune(const char *path, int epochs, int threads);
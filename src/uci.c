@@ -2,6 +2,7 @@
 #include <string.h>
 #include <stdbool.h>
 #include <stdlib.h>
+#include <inttypes.h>
 
 #include "uci.h"
 #include "timeman.h"
@@ -13,6 +14,18 @@
 #include "eval.h"
 #include "search.h"
 #include "hashtable.h"
+#include "movepicker.h"
+#include "nnue.h"
+#include "tune.h"
+#include "datagen.h"
+#include "batch.h"
+#include "pgn.h"
+#include "book.h"
+#include "makebook.h"
+#include "bitbase.h"
+#include "material.h"
+#include "mate.h"
+#include "mcts.h"
 
 /* -------------------------------------------------------------------------- */
 /*                                 UCI helpers                                */
@@ -28,9 +41,12 @@ void initEngine(Engine *engine) {
     memset(&engine->limits, 0, sizeof(SearchLimits));
     memset(&engine->searchStats, 0, sizeof(SearchInfo));
     engine->searchState = SEARCH_STOPPED;
+    engine->silent = false;
+    engine->pollInput = true;
 
-    // Clear hash table
+    // Clear hash table and move ordering history
     clearHashTable();
+    clearMoveHistory();
 }
 
 // Converts a string to a move.
@@ -95,7 +111,13 @@ void handleUci() {
     // Send available options
     printf("option name Hash type spin default %d min %d max %d\n", HASH_SIZE_DEFAULT, HASH_SIZE_MIN, HASH_SIZE_MAX);
     puts("option name Clear Hash type button");
-    puts("option name Threads type spin default 1 min 1 max 1");
+    printf("option name Threads type spin default 1 min 1 max %d\n", THREADS_MAX);
+    puts("option name SearchMode type combo default AlphaBeta var AlphaBeta var MTDf var MCTS");
+    puts("option name EvalFile type string default <empty>");
+    printf("option name UseNNUE type check default %s\n", useNNUE ? "true" : "false");
+    puts("option name BookFile type string default <empty>");
+    printf("option name BookBestMove type check default %s\n", bookBestMove ? "true" : "false");
+    puts("option name BitbasePath type string default <empty>");
 
     puts("uciok");
 }
@@ -122,6 +144,78 @@ void handleSetOption(char *input) {
         // Hash clear option
         puts("Hash table cleared.");
         clearHashTable();
+
+    } else if (strncmp(input, "setoption name Threads value ", 29) == 0) {
+        // Threads of the MCTS search, AlphaBeta and MTDf are single threaded and say so on go
+        int threads = atoi(input + 29);
+        searchThreads = (threads >= 1 && threads <= THREADS_MAX) ? threads : 1;
+
+    } else if (strncmp(input, "setoption name SearchMode value ", 32) == 0) {
+        // Root search driver option
+        if (strncmp(input + 32, "MCTS", 4) == 0)
+            searchMode = SEARCH_MODE_MCTS;
+        else if (strncmp(input + 32, "MTDf", 4) == 0)
+            searchMode = SEARCH_MODE_MTDF;
+        else
+            searchMode = SEARCH_MODE_ALPHA_BETA;
+
+    } else if (strncmp(input, "setoption name EvalFile value ", 30) == 0) {
+        // NNUE network file option
+        char *path = input + 30;
+        path[strcspn(path, "\r\n")] = '\0';
+
+        if (strcmp(path, "<empty>") == 0) {
+            // Default value, nothing to load
+        } else if (loadNetwork(path)) {
+            printf("info string Loaded network %s\n", path);
+            clearEvalCache();
+            clearHashTable();
+        } else {
+            printf("info string Failed to load network %s\n", path);
+        }
+
+    } else if (strncmp(input, "setoption name UseNNUE value ", 29) == 0) {
+        // NNUE or hand crafted evaluation option
+        useNNUE = strncmp(input + 29, "true", 4) == 0;
+
+        if (useNNUE && !networkIsLoaded()) {
+            puts("info string No network loaded, set EvalFile first");
+            useNNUE = false;
+        }
+
+        // Cached evaluations are from the other evaluation function
+        clearEvalCache();
+        clearHashTable();
+
+    } else if (strncmp(input, "setoption name BookFile value ", 30) == 0) {
+        // Polyglot opening book option
+        char *path = input + 30;
+        path[strcspn(path, "\r\n")] = '\0';
+
+        if (strcmp(path, "<empty>") == 0) {
+            closeBook();
+        } else if (openBook(path)) {
+            printf("info string Loaded book %s\n", path);
+        } else {
+            printf("info string Failed to load book %s\n", path);
+        }
+
+    } else if (strncmp(input, "setoption name BookBestMove value ", 34) == 0) {
+        // Play the best book move instead of a weighted random one
+        bookBestMove = strncmp(input + 34, "true", 4) == 0;
+
+    } else if (strncmp(input, "setoption name BitbasePath value ", 33) == 0) {
+        // Endgame bitbase directory option
+        char *path = input + 33;
+        path[strcspn(path, "\r\n")] = '\0';
+
+        if (strcmp(path, "<empty>") != 0) {
+            printf("info string Loaded %d bitbases from %s\n", loadBitbases(path), path);
+
+            // Cached KPK evaluations were scaled without the bitbases
+            clearEvalCache();
+            clearHashTable();
+        }
     }
 }
 
@@ -129,6 +223,8 @@ void handleSetOption(char *input) {
 void handleUciNewGame(Engine *engine) {
     parseFen(&engine->board, START_FEN);
     clearHashTable();
+    clearEvalCache();
+    clearMoveHistory();
     puts("readyok");
 }
 
@@ -192,6 +288,7 @@ void handleGo(Engine *engine, char *input) {
     int wtime = -1, btime = -1;
     int winc = 0, binc = 0;
     int movesToGo = -1;
+    int mateMoves = 0;
 
     // Parse UCI go parameters
     index = strstr(input, "wtime");
@@ -233,6 +330,12 @@ void handleGo(Engine *engine, char *input) {
         limits.searchType = LIMIT_INFINITE;
     }
 
+    index = strstr(input, "mate");
+    if (index) {
+        mateMoves = atoi(index + 5);
+        if (mateMoves <= 0) mateMoves = 1;
+    }
+
     // If wtime or btime, then we're in a time limited search.
     if (wtime > 0 || btime > 0) limits.searchType = LIMIT_TIME;
 
@@ -252,19 +355,42 @@ void handleGo(Engine *engine, char *input) {
         limits.softBoundTime = getTime() + moveTime;
     }
 
+    // Solve mates with the mate search
+    if (mateMoves) {
+        initSearch(engine, limits);
+        printf("bestmove %s\n", moveToString(mateSearch(engine, mateMoves)));
+        return;
+    }
+
+    // Play straight from the opening book, unless we're analysing
+    if (limits.searchType != LIMIT_INFINITE) {
+        Move bookMove = probeBook(&engine->board);
+        if (bookMove != NO_MOVE) {
+            printf("info string Book move\n");
+            printf("bestmove %s\n", moveToString(bookMove));
+            return;
+        }
+    }
+
+    // Only MCTS uses more than one thread, so say so instead of silently ignoring Threads
+    if (searchThreads > 1 && searchMode != SEARCH_MODE_MCTS)
+        printf("info string Threads is only used by SearchMode MCTS, searching with 1 thread\n");
+
     // Start the search within the given limits
     initSearch(engine, limits);
-    Move bestMove = iterativeDeepening(engine);
+    Move bestMove = (searchMode == SEARCH_MODE_MCTS) ? mctsSearch(engine) : iterativeDeepening(engine);
 
     // Print the result of the search
     printf("bestmove %s\n", moveToString(bestMove));
     printf("Hash table occupied: %.2f%%\n", occupiedHashEntries());
+    printf("Pawn hash hit rate: %.2f%%\n", pawnTableHitRate());
 }
 
 // Clean up before exiting
 void handleQuit() {
     // Free hash table
     cleanUpHashTable();
+    closeBook();
 }
 
 // Start perft from this position, defaults to 4
@@ -286,6 +412,95 @@ void handlePerft(Engine *engine, char *input) {
     }
 }
 
+// Runs the Texel tuner, tune <dataset> [epochs] [threads]
+void handleTune(char *input) {
+    char path[INPUT_BUFFER_SIZE];
+    int epochs = TUNE_DEFAULT_EPOCHS;
+    int threads = 0;
+
+    if (sscanf(input, "tune %s %d %d", path, &epochs, &threads) < 1) {
+        puts("Usage: tune <dataset> [epochs] [threads]");
+        return;
+    }
+
+    tune(path, epochs, threads);
+}
+
+// Generates self-play data, datagen <output> [positions] [nodes] [threads]
+void handleDatagen(char *input) {
+    char path[INPUT_BUFFER_SIZE];
+    uint64_t positions = DATAGEN_DEFAULT_POSITIONS;
+    int nodes = DATAGEN_DEFAULT_NODES;
+    int threads = 0;
+
+    if (sscanf(input, "datagen %s %" SCNu64 " %d %d", path, &positions, &nodes, &threads) < 1) {
+        puts("Usage: datagen <output> [positions] [nodes] [threads]");
+        return;
+    }
+
+    datagen(path, positions, nodes, threads);
+}
+
+// Evaluates or searches a file of packed positions, batch <eval|search> <file> [nodes] [threads]
+void handleBatch(char *input) {
+    char mode[INPUT_BUFFER_SIZE], path[INPUT_BUFFER_SIZE];
+    int nodes = BATCH_DEFAULT_NODES;
+    int threads = 0;
+
+    if (sscanf(input, "batch %s %s %d %d", mode, path, &nodes, &threads) < 2
+        || (strcmp(mode, "eval") != 0 && strcmp(mode, "search") != 0)) {
+        puts("Usage: batch <eval|search> <positions.bin> [nodes] [threads]");
+        return;
+    }
+
+    runBatchFile(path, strcmp(mode, "search") == 0, nodes, threads);
+}
+
+// Converts the games of a PGN into positions, pgn <input.pgn> <output> [threads]
+void handlePgn(char *input) {
+    char pgnPath[INPUT_BUFFER_SIZE], outputPath[INPUT_BUFFER_SIZE];
+    int threads = 0;
+
+    if (sscanf(input, "pgn %s %s %d", pgnPath, outputPath, &threads) < 2) {
+        puts("Usage: pgn <input.pgn> <output> [threads]");
+        return;
+    }
+
+    convertPgn(pgnPath, outputPath, threads);
+}
+
+// Builds an opening book from a PGN, makebook <input.pgn> <output.bin> [plies] [min games] [nodes] [threads]
+void handleMakeBook(char *input) {
+    char pgnPath[INPUT_BUFFER_SIZE], bookPath[INPUT_BUFFER_SIZE];
+    int plies = MAKEBOOK_DEFAULT_PLIES;
+    int minGames = MAKEBOOK_DEFAULT_MIN_GAMES;
+    int nodes = 0;
+    int threads = 0;
+
+    if (sscanf(input, "makebook %s %s %d %d %d %d", pgnPath, bookPath, &plies, &minGames, &nodes, &threads) < 2) {
+        puts("Usage: makebook <input.pgn> <output.bin> [plies] [min games] [nodes] [threads]");
+        return;
+    }
+
+    makeBook(pgnPath, bookPath, plies, minGames, nodes, threads);
+}
+
+// Generates the endgame bitbases, bitbases <directory> [threads]
+void handleBitbases(char *input) {
+    char directory[INPUT_BUFFER_SIZE];
+    int threads = 0;
+
+    if (sscanf(input, "bitbases %s %d", directory, &threads) < 1) {
+        puts("Usage: bitbases <directory> [threads]");
+        return;
+    }
+
+    generateBitbases(directory, threads);
+    checkKPKRules();
+    clearEvalCache();
+    clearHashTable();
+}
+
 /* -------------------------------------------------------------------------- */
 /*                                  UCI Loop                                  */
 /* -------------------------------------------------------------------------- */
@@ -345,10 +560,25 @@ void uciLoop() {
         } else if (strcmp(input, "bench") == 0) {
             // Run OpenBench benchmark
             bench();
+        } else if (strcmp(input, "sliderbench") == 0) {
+            // Compare slider attack implementations
+            sliderBench();
         } else if (strcmp(input, "print") == 0) {
             printBoard(&engine.board);
         } else if (strcmp(input, "eval") == 0) {
             printEvaluation(&engine.board);
+        } else if (strncmp(input, "tune ", 5) == 0) {
+            handleTune(input);
+        } else if (strncmp(input, "datagen ", 8) == 0) {
+            handleDatagen(input);
+        } else if (strncmp(input, "batch ", 6) == 0) {
+            handleBatch(input);
+        } else if (strncmp(input, "pgn ", 4) == 0) {
+            handlePgn(input);
+        } else if (strncmp(input, "makebook ", 9) == 0) {
+            handleMakeBook(input);
+        } else if (strncmp(input, "bitbases ", 9) == 0) {
+            handleBitbases(input);
         }
 
         /* Unknown command */
@@ -27,6 +27,7 @@
 #define HASH_SIZE_MAX 2048
 #define HASH_SIZE_DEFAULT 128
 #define HASH_SIZE_MIN 1
+#define THREADS_MAX 256
 
 // The exit condition of the search the engine is doing.
 typedef enum {
@@ -49,6 +50,22 @@ typedef struct {
     int length;
 } PV;
 
+// Continuation history table for one previous (piece, to) pair, indexed by
+// the colored piece and destination square of the current move.
+typedef int16_t PieceToHistory[NB_PIECES * 2][64];
+
+// Information about each ply of the current search line
+typedef struct {
+    PV pv;                    // Principal variation starting from this ply
+    int staticEval;           // Static evaluation, EVAL_NONE when in check
+    Move move;                // Move made from this ply, NO_MOVE for null moves
+    Move killers[2];          // Quiet moves which caused beta cutoffs at this ply
+    PieceToHistory *continuationHistory; // History of replies to the move made from this ply
+} SearchStack;
+
+// Sentinel entries before the root so (ss - 2) is always safe to read
+#define SEARCH_STACK_OFFSET 2
+
 // Limits for the search
 typedef struct {
     int depth;                // Depth to search to
@@ -64,16 +81,20 @@ typedef struct {
     U64 nodes;                // Number of nodes searched
     int seldepth;             // Max depth reached during search
     int searchStartTime;      // Time when the search started
+    int score;                // Score of the last completed iteration
 } SearchInfo;
 
 // The entire state of the engine
 typedef struct {
     Board board;
     PV pv;
+    SearchStack searchStack[MAX_PLY + SEARCH_STACK_OFFSET];
     SearchInfo searchStats;
     SearchLimits limits;
     SearchState searchState;
     bool reportCurrMove;
+    bool silent;              // Don't print info lines, e.g. when generating data
+    bool pollInput;           // Read stop and quit from stdin while searching, off for worker threads
 } Engine;
 
 /* -------------------------------------------------------------------------- */
@@ -83,3 +104,9 @@ typedef struct {
 void uciLoop();
 void initEngine(Engine *engine);
 void handleQuit();
+void handleTune(char *input);
+void handleDatagen(char *input);
+void handleBatch(char *input);
+void handlePgn(char *input);
+void handleMakeBook(char *input);
+void handleBitbases(char *input);
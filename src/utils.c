@@ -11,6 +11,68 @@ int getTime() {
 #endif
 }
 
+// Number of cores on this machine, the default number of worker threads
+int cpuCount() {
+#if defined(_WIN32) || defined(_WIN64)
+    SYSTEM_INFO info;
+    GetSystemInfo(&info);
+    return info.dwNumberOfProcessors;
+#else
+    return sysconf(_SC_NPROCESSORS_ONLN);
+#endif
+}
+
+/**
+ * Maps a file into memory. Datasets are only ever read once from start to
+ * end, so there is no point copying the whole file first.
+ */
+const char *mapFile(const char *path, size_t *size) {
+#if defined(_WIN32) || defined(_WIN64)
+    FILE *file = fopen(path, "rb");
+    if (file == NULL)
+        return NULL;
+
+    fseek(file, 0, SEEK_END);
+    *size = ftell(file);
+    fseek(file, 0, SEEK_SET);
+
+    char *data = malloc(*size + 1);
+    *size = fread(data, 1, *size, file);
+    fclose(file);
+    return data;
+#else
+    int fd = open(path, O_RDONLY);
+    if (fd < 0)
+        return NULL;
+
+    struct stat info;
+    if (fstat(fd, &info) < 0 || info.st_size == 0) {
+        close(fd);
+        return NULL;
+    }
+
+    *size = info.st_size;
+    void *data = mmap(NULL, *size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    return (data == MAP_FAILED) ? NULL : data;
+#endif
+}
+
+void unmapFile(const char *data, size_t size) {
+#if defined(_WIN32) || defined(_WIN64)
+    (void) size;
+    free((char *) data);
+#else
+    munmap((void *) data, size);
+#endif
+}
+
+bool hasExtension(const char *path, const char *extension) {
+    size_t pathLength = strlen(path);
+    size_t extensionLength = strlen(extension);
+    return pathLength > extensionLength && strcmp(path + pathLength - extensionLength, extension) == 0;
+}
+
 // XOR shift algorithm from Wikipedia
 // https://en.wikipedia.org/wiki/Xorshift
 U64 randomU64() {
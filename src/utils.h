@@ -15,6 +15,9 @@
     #include <sys/select.h>
     #include <unistd.h>
     #include <sys/time.h>
+    #include <sys/mman.h>
+    #include <sys/stat.h>
+    #include <fcntl.h>
 #endif
 
 // Width of line of user input for 'stop' while searching
@@ -51,6 +54,16 @@ int clamp(int x, int low, int high);
 // Gets the amount of milliseconds since the unix epoch.
 int getTime();
 
+// Number of cores, for tools which use every thread.
+int cpuCount();
+
+// Read only memory mapping of a whole file, for datasets. NULL if it can't be read.
+const char *mapFile(const char *path, size_t *size);
+void unmapFile(const char *data, size_t size);
+
+// Checks if a file path ends with the extension, e.g. ".bin"
+bool hasExtension(const char *path, const char *extension);
+
 // Generates a random U64 number using XORSHIFT.
 U64 randomU64();
 
@@ -8,5 +8,11 @@ extern U64 EpKeys[64];
 extern U64 CastleKeys[16];
 extern U64 SideKey;
 
+// Opening book keys, see polyglotKey
+#define POLYGLOT_KEYS 781
+extern const U64 PolyglotKeys[POLYGLOT_KEYS];
+
 U64 generateHash(Board *board);
+U64 generatePawnHash(Board *board);
+U64 polyglotKey(Board *board);
 void initZobristKeys();